@@ -0,0 +1,303 @@
+/*
+Copyright (c) 2020 Daniel Stahlke
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+
+// Throughput benchmark for sending data to gnuplot.  Every combination of container, array
+// organization and transport is written to a Gnuplot object that goes to /dev/null, and one
+// tab separated line is printed per case:
+//
+//     container  mode  method  rows  bytes  seconds  MB/s  rows/s  allocs
+//
+// `seconds` and `allocs` are per run (the average of several runs).  An optional argument
+// scales the size of the data, e.g. `./bench-send 0.1` for a quick check.  Compile with
+// optimization, or the numbers mean nothing.
+
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#if USE_ARMA
+#include <armadillo>
+#endif
+
+#ifdef USE_EIGEN
+#include <Eigen/Dense>
+#endif
+
+#if USE_BLITZ
+#include <blitz/array.h>
+#endif
+
+#include "gnuplot-iostream.h"
+
+using namespace gnuplotio;
+
+// {{{1 Allocation counting
+
+static std::atomic<size_t> num_allocs(0);
+
+// GCC sees the malloc/free inside these replacements after inlining them into new/delete
+// expressions, and warns about a mismatch that isn't one.
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void *operator new(size_t size) {
+    ++num_allocs;
+    if(void *p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    std::free(p);
+}
+
+// }}}1
+
+// {{{1 Byte counting
+
+// Counts the bytes passing through on their way to the real stream buffer.  It has its own
+// buffer so that the counting doesn't add a virtual call per value.
+class CountingBuf : public std::streambuf {
+public:
+    explicit CountingBuf(std::streambuf *_dest) : dest(_dest), buf(1 << 16), total(0) {
+        setp(buf.data(), buf.data() + buf.size());
+    }
+
+    size_t bytes() const {
+        return total + (pptr() - pbase());
+    }
+
+protected:
+    int_type overflow(int_type c) override {
+        if(drain()) return traits_type::eof();
+        if(!traits_type::eq_int_type(c, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    int sync() override {
+        if(drain()) return -1;
+        return dest->pubsync();
+    }
+
+private:
+    int drain() {
+        const std::streamsize n = pptr() - pbase();
+        if(n && dest->sputn(pbase(), n) != n) return -1;
+        total += n;
+        setp(buf.data(), buf.data() + buf.size());
+        return 0;
+    }
+
+    std::streambuf *dest;
+    std::vector<char> buf;
+    size_t total;
+};
+
+// }}}1
+
+// {{{1 Benchmark driver
+
+Gnuplot gp(">/dev/null");
+CountingBuf *counter;
+const std::string tmp_fn = "bench-send.tmp";
+
+size_t file_size(const std::string &fn) {
+    std::ifstream f(fn, std::ios::binary | std::ios::ate);
+    return static_cast<size_t>(f.tellg());
+}
+
+// Runs `f` (which returns the number of bytes it wrote) enough times to get a stable timing.
+template <typename F>
+void run_case(const std::string &container, const std::string &mode, const std::string &method, size_t rows, F &&f) {
+    f(); // warm up
+    const double min_seconds = 0.2;
+    size_t runs = 0;
+    size_t bytes = 0;
+    const size_t allocs_before = num_allocs;
+    const auto start = std::chrono::steady_clock::now();
+    double seconds;
+    do {
+        bytes = f();
+        ++runs;
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    } while(seconds < min_seconds);
+    const double allocs = double(num_allocs - allocs_before) / runs;
+    seconds /= runs;
+
+    std::printf("%s\t%s\t%s\t%zu\t%zu\t%.6g\t%.2f\t%.0f\t%.0f\n",
+        container.c_str(), mode.c_str(), method.c_str(), rows, bytes, seconds,
+        bytes / seconds / 1e6, rows / seconds, allocs);
+    std::fflush(stdout);
+}
+
+// Inline text and binary, and text and binary files, for one organization mode.
+template <typename T, typename OrganizationMode>
+void bench_mode(const std::string &container, const T &arg, size_t rows, OrganizationMode) {
+    const std::string mode = OrganizationMode::class_name();
+    run_case(container, mode, "send", rows, [&]() {
+        const size_t b0 = counter->bytes();
+        gp.send(arg, OrganizationMode());
+        return counter->bytes() - b0;
+    });
+    run_case(container, mode, "sendBinary", rows, [&]() {
+        const size_t b0 = counter->bytes();
+        gp.sendBinary(arg, OrganizationMode());
+        return counter->bytes() - b0;
+    });
+    run_case(container, mode, "file", rows, [&]() {
+        gp.file(arg, tmp_fn, OrganizationMode());
+        return file_size(tmp_fn);
+    });
+    run_case(container, mode, "binaryFile", rows, [&]() {
+        gp.binaryFile(arg, tmp_fn, "record", OrganizationMode());
+        return file_size(tmp_fn);
+    });
+}
+
+// PlotGroup serialization (buffered and by reference) of two 1D plots.
+template <typename T>
+void bench_plotgroup(const std::string &container, const T &arg, size_t rows) {
+    for(bool by_ref : {false, true}) {
+        for(const char *fmt : {"text", "record"}) {
+            const std::string method = std::string(by_ref ? "PlotGroup/by_reference/" : "PlotGroup/") + fmt;
+            run_case(container, "Mode1D", method, 2*rows, [&]() {
+                const size_t b0 = counter->bytes();
+                gp.send(Gnuplot::plotGroup().by_reference(by_ref)
+                    .add_plot1d(arg, "with lines", fmt)
+                    .add_plot1d(arg, "with points", fmt));
+                return counter->bytes() - b0;
+            });
+        }
+    }
+}
+
+// }}}1
+
+int main(int argc, char **argv) {
+    const double scale = argc > 1 ? std::atof(argv[1]) : 1.0;
+    const size_t N = std::max<size_t>(10, size_t(200000 * scale));
+    const size_t NX = std::max<size_t>(10, size_t(500 * std::sqrt(scale)));
+    const size_t NY = NX;
+
+    std::streambuf *orig_buf = gp.rdbuf();
+    CountingBuf buf(orig_buf);
+    gp.rdbuf(&buf);
+    counter = &buf;
+
+    std::printf("container\tmode\tmethod\trows\tbytes\tseconds\tMB/s\trows/s\tallocs\n");
+
+    std::vector<double> vx(N), vy(N), vz(N);
+    for(size_t i=0; i<N; i++) {
+        vx[i] = i * 0.001;
+        vy[i] = std::sin(vx[i]);
+        vz[i] = std::cos(vx[i]);
+    }
+
+    bench_mode("vector<double>", vy, N, Mode1D());
+    bench_plotgroup("vector<double>", vy, N);
+
+    std::vector<std::pair<double, double>> vpair(N);
+    for(size_t i=0; i<N; i++) vpair[i] = std::make_pair(vx[i], vy[i]);
+    bench_mode("vector<pair>", vpair, N, Mode1D());
+    bench_plotgroup("vector<pair>", vpair, N);
+
+    bench_mode("pair<vector>", std::make_pair(vx, vy), N, Mode1D());
+
+    bench_mode("tuple<vector>", std::make_tuple(vx, vy, vz), N, Mode1D());
+
+    // Each inner vector is a row of NY values.
+    std::vector<std::vector<double>> vv(NX, std::vector<double>(NY));
+    for(size_t i=0; i<NX; i++) {
+        for(size_t j=0; j<NY; j++) {
+            vv[i][j] = std::sin(i * 0.01) * std::cos(j * 0.01);
+        }
+    }
+    bench_mode("vector<vector>", vv, NX, Mode1D());
+    bench_mode("vector<vector>", vv, NX*NY, Mode2D());
+    bench_mode("vector<vector>", vv, NX, Mode1DUnwrap());
+
+    // A grid of (x,y,z) points, for the 2D column-major mode.
+    std::vector<std::vector<std::vector<double>>> vvv(3,
+        std::vector<std::vector<double>>(NX, std::vector<double>(NY)));
+    for(size_t i=0; i<NX; i++) {
+        for(size_t j=0; j<NY; j++) {
+            vvv[0][i][j] = i;
+            vvv[1][i][j] = j;
+            vvv[2][i][j] = vv[i][j];
+        }
+    }
+    bench_mode("vector<vector<vector>>", vvv, NX*NY, Mode2DUnwrap());
+
+#if USE_ARMA
+    arma::mat armamat(NX, NY);
+    for(size_t i=0; i<NX; i++) for(size_t j=0; j<NY; j++) armamat(i, j) = vv[i][j];
+    bench_mode("arma::mat", armamat, NX, Mode1D());
+    bench_mode("arma::mat", armamat, NX*NY, Mode2D());
+    bench_mode("arma::mat", armamat, NY, Mode1DUnwrap());
+    arma::vec armavec(N);
+    for(size_t i=0; i<N; i++) armavec(i) = vy[i];
+    bench_mode("arma::vec", armavec, N, Mode1D());
+#endif
+
+#ifdef USE_EIGEN
+    Eigen::MatrixXd eigenmat(NX, NY);
+    for(size_t i=0; i<NX; i++) for(size_t j=0; j<NY; j++) eigenmat(i, j) = vv[i][j];
+    bench_mode("Eigen::MatrixXd", eigenmat, NX, Mode1D());
+    bench_mode("Eigen::MatrixXd", eigenmat, NX*NY, Mode2D());
+    bench_mode("Eigen::MatrixXd", eigenmat, NY, Mode1DUnwrap());
+    Eigen::VectorXd eigenvec(N);
+    for(size_t i=0; i<N; i++) eigenvec(i) = vy[i];
+    bench_mode("Eigen::VectorXd", eigenvec, N, Mode1D());
+#endif
+
+#if USE_BLITZ
+    blitz::Array<double, 2> blitz2d(NX, NY);
+    for(size_t i=0; i<NX; i++) for(size_t j=0; j<NY; j++) blitz2d(i, j) = vv[i][j];
+    bench_mode("blitz::Array<2>", blitz2d, NX, Mode1D());
+    bench_mode("blitz::Array<2>", blitz2d, NX*NY, Mode2D());
+    bench_mode("blitz::Array<2>", blitz2d, NY, Mode1DUnwrap());
+    blitz::Array<double, 1> blitz1d(N);
+    for(size_t i=0; i<N; i++) blitz1d(i) = vy[i];
+    bench_mode("blitz::Array<1>", blitz1d, N, Mode1D());
+#endif
+
+    gp.flush();
+    gp.rdbuf(orig_buf);
+    std::remove(tmp_fn.c_str());
+}
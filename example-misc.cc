@@ -300,6 +300,31 @@ void demo_animation() {
     }
 }
 
+void demo_stripchart() {
+#ifdef _WIN32
+    // See the comment in demo_animation().
+    std::cout << "Sorry, the stripchart demo doesn't work in Windows." << std::endl;
+    return;
+#endif
+
+    Gnuplot gp;
+
+    std::cout << "Press Ctrl-C to quit (closing gnuplot window doesn't quit)." << std::endl;
+
+    gp << "set yrange [-1.5:1.5]\n";
+
+    // Keep the last 500 samples of two signals, and redraw at most 20 times per second.
+    gnuplotio::StripChart<2> chart(gp, 500, 20);
+    chart.plotspec(0, "with lines title 'sin'");
+    chart.plotspec(1, "with lines title 'cos'");
+
+    for(double t=0; ; t+=0.01) {
+        chart.push(t, sin(t*3), cos(t*5)*0.5);
+        chart.update();
+        mysleep(5);
+    }
+}
+
 void demo_NaN() {
     // Demo of NaN (not-a-number) usage.  Plot a circle that has half the coordinates replaced
     // by NaN values.
@@ -398,6 +423,31 @@ void demo_image() {
     pause_if_needed();
 }
 
+void demo_rgbimage() {
+    // An 8 bit RGB buffer, like a camera frame, plotted without converting the pixels.  The
+    // image is placed so that it covers [-1,1] x [-1,1].
+    Gnuplot gp;
+
+    const size_t width = 320, height = 240;
+    std::vector<uint8_t> frame(width * height * 3);
+    for(size_t j=0; j<height; j++) {
+        for(size_t i=0; i<width; i++) {
+            uint8_t *pixel = &frame[(j*width + i) * 3];
+            pixel[0] = static_cast<uint8_t>(255 * i / width);
+            pixel[1] = static_cast<uint8_t>(255 * j / height);
+            pixel[2] = 128;
+        }
+    }
+
+    auto view = gnuplotio::rgb_view(frame.data(), width, height);
+    gp << "set size ratio -1\n";
+    gp << "plot '-' " << gp.imageFmt(view, gnuplotio::image_extent(-1, 1, -1, 1, width, height))
+        << "with rgbimage notitle\n";
+    gp.sendImage(view);
+
+    pause_if_needed();
+}
+
 void demo_plotgroup() {
     Gnuplot gp;
     // For debugging or manual editing of commands:
@@ -428,6 +478,9 @@ void demo_plotgroup() {
     if(0) {
         // One way to do it:
         auto plots = gp.plotGroup();
+        // Plot directly from the vectors rather than from a copy of the data.  The vectors must
+        // then stay alive (and unchanged) until the group is sent.
+        plots.by_reference();
         plots.add_plot1d(xy_pts_A, "with lines title 'cubic'");
         // For this one, save the data in a file and plot that file (rather than sending
         // directly to gnuplot's stdin).
@@ -479,9 +532,11 @@ int main(int argc, char **argv) {
     demos["script_external_text"]   = demo_external_text;
     demos["script_external_binary"] = demo_external_binary;
     demos["animation"]              = demo_animation;
+    demos["stripchart"]             = demo_stripchart;
     demos["nan"]                    = demo_NaN;
     demos["segments"]               = demo_segments;
     demos["image"]                  = demo_image;
+    demos["rgbimage"]               = demo_rgbimage;
     demos["plotgroup"]              = demo_plotgroup;
     demos["fit"]                    = demo_fit;
 
@@ -47,12 +47,16 @@ THE SOFTWARE.
 #ifdef GNUPLOT_ENABLE_PTY
 #    include <termios.h>
 #    include <unistd.h>
+#    include <cerrno>
 #ifdef __APPLE__
 #    include <util.h>
 #else
 #    include <pty.h>
 #endif
 #endif // GNUPLOT_ENABLE_PTY
+#ifndef _WIN32
+#    include <poll.h>
+#endif
 
 // C++ system includes
 #include <fstream>
@@ -65,10 +69,33 @@ THE SOFTWARE.
 #include <vector>
 #include <complex>
 #include <cstdint>
+#include <cstring>
 #include <cstdlib>
 #include <cmath>
 #include <tuple>
 #include <type_traits>
+#include <charconv>
+#include <array>
+#include <algorithm>
+#include <limits>
+#include <functional>
+#include <memory>
+#include <deque>
+#include <map>
+#include <cctype>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <chrono>
+#include <optional>
+#include <atomic>
+
+#if defined(__AVX__)
+#    include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#    include <emmintrin.h>
+#endif
 
 #include <boost/iostreams/device/file_descriptor.hpp>
 #include <boost/iostreams/stream.hpp>
@@ -81,6 +108,12 @@ THE SOFTWARE.
 #    include <boost/filesystem.hpp>
 #endif // BOOST_VERSION
 
+// Floating point support for std::to_chars came late to some C++17 standard libraries.  Without
+// it, floating point values are formatted using the ostream `<<` operator.
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+#    define GNUPLOT_HAVE_FLOAT_TO_CHARS
+#endif
+
 // Note: this is here for reverse compatibility.  The new way to enable blitz support is to
 // just include the gnuplot-iostream.h header after you include the blitz header (likewise for
 // armadillo).
@@ -154,6 +187,12 @@ namespace gnuplotio {
 template <typename T, typename=void>
 static constexpr bool dont_treat_as_stl_container = false;
 
+// Specialized for small wrapper objects (such as the one returned by `as_float()`) that refer to
+// data held elsewhere.  These are copied, rather than referred to, by PlotGroup::by_reference(),
+// since they are usually temporaries.
+template <typename T>
+static constexpr bool is_view_type = false;
+
 
 template <typename T, typename=void>
 static constexpr bool is_like_stl_container = false;
@@ -202,13 +241,77 @@ static_assert(!is_boost_tuple<std::tuple<int, int>>);
 // }}}1
 
 // {{{1 Tmpfile helper class
+
+// Single quoted gnuplot string (no escapes are processed, except '' for a quote).
+inline std::string quote_string(const std::string &str) {
+    std::string ret = "'";
+    for(char c : str) {
+        if(c == '\'') ret += '\'';
+        ret += c;
+    }
+    return ret + "'";
+}
+
+// Calls `write` on a staging file, which is then renamed to `filename`.  A reader that already
+// opened `filename` keeps reading the old contents, and no reader ever sees a partly written
+// file.
+template <typename F>
+void replace_file(const std::string &filename, bool binary, F &&write) {
+    const std::string staging = filename + ".new";
+    {
+        std::ios_base::openmode mode = std::fstream::out | std::fstream::trunc;
+        if(binary) mode |= std::fstream::binary;
+        std::fstream fh(staging.c_str(), mode);
+        try {
+            write(fh);
+            if(!fh) throw std::ios_base::failure("cannot write file "+staging);
+        } catch(...) {
+            fh.close();
+            std::remove(staging.c_str());
+            throw;
+        }
+    }
+#ifdef GNUPLOT_USE_TMPFILE
+    boost::filesystem::rename(staging, filename);
+#else
+    std::remove(filename.c_str());
+    if(std::rename(staging.c_str(), filename.c_str())) {
+        throw std::ios_base::failure("cannot rename "+staging+" to "+filename);
+    }
+#endif
+}
+
+// Like replace_file() if `staged`, otherwise the file is truncated and written in place.
+template <typename F>
+void rewrite_file(const std::string &filename, bool binary, bool staged, F &&write) {
+    if(staged) {
+        replace_file(filename, binary, write);
+        return;
+    }
+    std::ios_base::openmode mode = std::fstream::out | std::fstream::trunc;
+    if(binary) mode |= std::fstream::binary;
+    std::fstream fh(filename.c_str(), mode);
+    write(fh);
+}
+
+// Counts of files handed out by GnuplotTmpfileCollection.
+struct GnuplotTmpfileStats {
+    // Files that were created.
+    size_t created = 0;
+    // Times an existing file was handed out again, to be overwritten.
+    size_t reused = 0;
+    // Files that currently exist.
+    size_t live = 0;
+};
+
 #ifdef GNUPLOT_USE_TMPFILE
 // RAII temporary file.  File is removed when this object goes out of scope.
 class GnuplotTmpfile {
 public:
-    explicit GnuplotTmpfile(bool _debug_messages) :
+    // The file is created in `dir`, or in the system temp directory if `dir` is empty.
+    explicit GnuplotTmpfile(bool _debug_messages, const std::string &dir="") :
         file(boost::filesystem::unique_path(
-            boost::filesystem::temp_directory_path() /
+            (dir.empty() ? boost::filesystem::temp_directory_path() : boost::filesystem::path(dir)) /
             "tmp-gnuplot-%%%%-%%%%-%%%%-%%%%")),
         debug_messages(_debug_messages)
     {
@@ -242,21 +345,137 @@ public:
 
 class GnuplotTmpfileCollection {
 public:
+    GnuplotTmpfileCollection() : ring_size(3), min_ring_size(1), max_files(0), staged(false) { }
+
+    // If `max_files` files already exist, the oldest one is handed out again rather than
+    // creating a new one.  The caller should write it with rewrite_file(..., use_staging()).
     std::string make_tmpfile() {
-        const bool debug_messages = false;
-        std::shared_ptr<GnuplotTmpfile> tmp_file(new GnuplotTmpfile(debug_messages));
+        if(max_files && tmp_files.size() >= max_files) {
+            std::shared_ptr<GnuplotTmpfile> tmp_file = tmp_files.front();
+            tmp_files.pop_front();
+            tmp_files.push_back(tmp_file);
+            ++stats.reused;
+            return tmp_file->file.string();
+        }
+        std::shared_ptr<GnuplotTmpfile> tmp_file = create();
         // The file will be removed once the pointer is removed from the
         // tmp_files container.
         tmp_files.push_back(tmp_file);
         return tmp_file->file.string();
     }
 
+    // Each slot (e.g. each plot of a PlotGroup that is sent over and over) cycles through a
+    // ring of `ring_size` files.  A file is only replaced after the other files of its ring
+    // have been used, which gives gnuplot time to get to it.  The caller should write the file
+    // with rewrite_file(..., use_staging()).
+    std::string slot_tmpfile(size_t slot) {
+        if(slot >= slot_rings.size()) slot_rings.resize(slot+1);
+        SlotRing &ring = slot_rings[slot];
+        std::string ret;
+        if(ring.files.size() < ring_size) {
+            ring.files.push_back(create());
+            ret = ring.files.back()->file.string();
+        } else {
+            ring.next %= ring.files.size();
+            ret = ring.files[ring.next]->file.string();
+            ++stats.reused;
+        }
+        ring.next++;
+        return ret;
+    }
+
+    // A file that belongs to `name` for as long as this collection exists (or until clear()).
+    // These don't count towards `max_files`, so they are never handed out to anything else.
+    std::string named_tmpfile(const std::string &name) {
+        std::shared_ptr<GnuplotTmpfile> &tmp_file = named_files[name];
+        if(!tmp_file) {
+            tmp_file = create();
+        } else {
+            ++stats.reused;
+        }
+        return tmp_file->file.string();
+    }
+
+    // Deletes the file of named_tmpfile(name), if there is one.
+    void drop_named_tmpfile(const std::string &name) {
+        named_files.erase(name);
+    }
+
+    // Empty means the system temp directory.  Only affects files created after this call.
+    void set_directory(const std::string &dir) {
+        directory = dir;
+    }
+
+    // `max_files` of zero means no limit.  See use_staging().
+    void set_pool_size(size_t _ring_size, size_t _max_files, bool _staged) {
+        if(_ring_size == 0) throw std::logic_error("ring_size must be at least 1");
+        if(_ring_size < min_ring_size) {
+            throw std::logic_error("ring_size must be larger than the async writer's max_queue");
+        }
+        ring_size = _ring_size;
+        max_files = _max_files;
+        staged = _staged;
+        // Commands that are still on their way to gnuplot may refer to the files that no longer
+        // fit, so these are kept until clear().
+        for(SlotRing &ring : slot_rings) {
+            while(ring.files.size() > ring_size) {
+                retired.push_back(ring.files.back());
+                ring.files.pop_back();
+            }
+        }
+        while(max_files && tmp_files.size() > max_files) {
+            retired.push_back(tmp_files.front());
+            tmp_files.pop_front();
+        }
+    }
+
+    // Whether files that are handed out again should be replaced through a staging file rather
+    // than overwritten in place (see Gnuplot::setTmpfilePool).
+    bool use_staging() const { return staged; }
+
+    // Makes the rings at least this long (see Gnuplot::useAsyncWriter).
+    void set_min_ring_size(size_t n) {
+        min_ring_size = n;
+        ring_size = std::max(ring_size, n);
+    }
+
+    GnuplotTmpfileStats get_stats() const {
+        GnuplotTmpfileStats ret = stats;
+        ret.live = tmp_files.size() + named_files.size() + retired.size();
+        for(const SlotRing &ring : slot_rings) ret.live += ring.files.size();
+        return ret;
+    }
+
     void clear() {
         tmp_files.clear();
+        slot_rings.clear();
+        named_files.clear();
+        retired.clear();
     }
 
 private:
-    std::vector<std::shared_ptr<GnuplotTmpfile>> tmp_files;
+    std::shared_ptr<GnuplotTmpfile> create() {
+        const bool debug_messages = false;
+        ++stats.created;
+        return std::shared_ptr<GnuplotTmpfile>(new GnuplotTmpfile(debug_messages, directory));
+    }
+
+    struct SlotRing {
+        std::vector<std::shared_ptr<GnuplotTmpfile>> files;
+        size_t next = 0;
+    };
+
+    std::deque<std::shared_ptr<GnuplotTmpfile>> tmp_files;
+    std::vector<SlotRing> slot_rings;
+    std::map<std::string, std::shared_ptr<GnuplotTmpfile>> named_files;
+    // Files dropped by set_pool_size().
+    std::vector<std::shared_ptr<GnuplotTmpfile>> retired;
+    std::string directory;
+    size_t ring_size;
+    size_t min_ring_size;
+    size_t max_files;
+    bool staged;
+    GnuplotTmpfileStats stats;
 };
 #else // GNUPLOT_USE_TMPFILE
 class GnuplotTmpfileCollection {
@@ -265,6 +484,26 @@ public:
         throw std::logic_error("no filename given and temporary files not enabled");
     }
 
+    std::string slot_tmpfile(size_t) {
+        throw std::logic_error("temporary files not enabled");
+    }
+
+    std::string named_tmpfile(const std::string &) {
+        throw std::logic_error("temporary files not enabled");
+    }
+
+    void drop_named_tmpfile(const std::string &) { }
+
+    void set_directory(const std::string &) { }
+
+    void set_pool_size(size_t, size_t, bool) { }
+
+    bool use_staging() const { return false; }
+
+    void set_min_ring_size(size_t) { }
+
+    GnuplotTmpfileStats get_stats() const { return GnuplotTmpfileStats(); }
+
     void clear() { }
 };
 #endif // GNUPLOT_USE_TMPFILE
@@ -288,6 +527,10 @@ public:
     virtual ~GnuplotFeedback() { }
     virtual std::string filename() const = 0;
     virtual FILE *handle() const = 0;
+    // Reads one line (without the line terminator).  Returns false if no complete line arrived
+    // within `timeout_ms` milliseconds.  A negative timeout waits forever.  Don't mix this with
+    // reading from handle(), since each has its own buffer.
+    virtual bool read_line(std::string &line, int timeout_ms) = 0;
 
 private:
     // noncopyable
@@ -295,6 +538,19 @@ private:
     const GnuplotFeedback& operator=(const GnuplotFeedback &);
 };
 
+// An event delivered to the callback given to Gnuplot::subscribeEvents().
+struct GnuplotEvent {
+    enum Type { Key, Button, Close };
+    Type type = Key;
+    // Name of the key for Key events, e.g. "a" or "Escape".
+    std::string key;
+    // 1, 2, or 3 for Button events.
+    int button = 0;
+    // Mouse position in plot coordinates, or NaN if the mouse is not over a plot.
+    double x = 0;
+    double y = 0;
+};
+
 #ifdef GNUPLOT_ENABLE_PTY
 #define GNUPLOT_ENABLE_FEEDBACK
 class GnuplotFeedbackPty : public GnuplotFeedback {
@@ -358,10 +614,51 @@ public:
         return pty_fh;
     }
 
+    bool read_line(std::string &line, int timeout_ms) {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        for(;;) {
+            size_t eol = buf.find('\n');
+            if(eol != std::string::npos) {
+                line = buf.substr(0, eol);
+                buf.erase(0, eol+1);
+                // The terminal turns "\n" into "\r\n".
+                line.erase(std::remove(line.begin(), line.end(), '\r'), line.end());
+                return true;
+            }
+
+            int wait_ms = -1;
+            if(timeout_ms >= 0) {
+                wait_ms = static_cast<int>(std::max<long long>(0,
+                    std::chrono::duration_cast<std::chrono::milliseconds>(
+                        deadline - std::chrono::steady_clock::now()).count()));
+            }
+            struct pollfd pfd;
+            pfd.fd = master_fd;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            int ret = poll(&pfd, 1, wait_ms);
+            if(ret < 0) {
+                if(errno == EINTR) continue;
+                perror("poll");
+                throw std::runtime_error("poll failed");
+            }
+            if(ret == 0) return false;
+
+            // poll said there is data, so this won't block.
+            char tmp[4096];
+            ssize_t n = ::read(master_fd, tmp, sizeof(tmp));
+            if(n < 0 && errno == EINTR) continue;
+            if(n <= 0) throw std::runtime_error("feedback channel from gnuplot was closed");
+            buf.append(tmp, static_cast<size_t>(n));
+        }
+    }
+
 private:
     std::string pty_fn;
     FILE *pty_fh;
     int master_fd, slave_fd;
+    // Data read by read_line() but not yet returned.
+    std::string buf;
 };
 //#elif defined GNUPLOT_USE_TMPFILE
 //// Currently this doesn't work since fscanf doesn't block (need something like "tail -f")
@@ -453,6 +750,42 @@ struct FlatBinarySender {
     }
 };
 
+// FlatBinaryLayout tells whether the binary representation of a datatype (as sent by
+// BinarySender) is identical to the way the datatype is stored in memory.  Arrays of such types
+// can be sent with a single write rather than element by element.  Compound types (such as
+// std::pair) are flat if all of their members are flat, but since the placement of members in
+// memory is implementation defined (e.g. some implementations store std::tuple members in
+// reverse order) this must be double checked at runtime using `has_flat_binary_layout()`.
+template <typename T, typename Enable=void>
+struct FlatBinaryLayout {
+    static constexpr bool is_flat = false;
+};
+
+template <typename T>
+struct FlatBinaryLayout<T,
+    typename std::enable_if_t<std::is_base_of_v<FlatBinarySender<T>, BinarySender<T>>>
+> {
+    static constexpr bool is_flat = true;
+
+    // Checks that `v` is stored at the given offset from `base`, and advances the offset past
+    // it.
+    static bool matches_at(const T &v, const char *base, size_t &offset) {
+        bool ret = (reinterpret_cast<const char *>(&v) == base + offset);
+        offset += sizeof(T);
+        return ret;
+    }
+};
+
+// Tells whether the memory layout of `v` is exactly what BinarySender would send, with no
+// padding and with members in the order that they are sent.
+template <typename T>
+bool has_flat_binary_layout(const T &v) {
+    static_assert(FlatBinaryLayout<T>::is_flat, "type does not have a flat binary layout");
+    size_t offset = 0;
+    bool ret = FlatBinaryLayout<T>::matches_at(v, reinterpret_cast<const char *>(&v), offset);
+    return ret && offset == sizeof(T);
+}
+
 // Default BinfmtSender, raises a compile time error.
 template <typename T, typename Enable=void>
 struct BinfmtSender {
@@ -486,11 +819,42 @@ template<> struct BinarySender<uint32_t> : public FlatBinarySender<uint32_t> { }
 template<> struct BinarySender< int64_t> : public FlatBinarySender< int64_t> { };
 template<> struct BinarySender<uint64_t> : public FlatBinarySender<uint64_t> { };
 
+// Numbers are formatted with std::to_chars into a local buffer, which is much faster than the
+// ostream `<<` operator (and is independent of the locale, which is good since gnuplot always
+// expects a '.' decimal point).  The stream's formatting flags are honored.  Flags that
+// to_chars can't reproduce (such as `std::setw` or `std::showpos`) cause a fallback to `<<`.
+inline bool to_chars_can_format(const std::ostream &stream) {
+    return stream.width() == 0 && !(stream.flags() &
+        (std::ios_base::showpos | std::ios_base::showpoint | std::ios_base::uppercase));
+}
+
+template <typename T>
+struct IntTextSender {
+    static void send(std::ostream &stream, const T &v) {
+        const std::ios_base::fmtflags base = stream.flags() & std::ios_base::basefield;
+        if(to_chars_can_format(stream) && (base == std::ios_base::dec || base == 0)) {
+            char buf[std::numeric_limits<T>::digits10 + 3];
+            std::to_chars_result res = std::to_chars(buf, buf + sizeof(buf), v);
+            stream.write(buf, res.ptr - buf);
+        } else {
+            stream << v;
+        }
+    }
+};
+template<> struct TextSender<         short> : public IntTextSender<         short> { };
+template<> struct TextSender<unsigned short> : public IntTextSender<unsigned short> { };
+template<> struct TextSender<           int> : public IntTextSender<           int> { };
+template<> struct TextSender<  unsigned int> : public IntTextSender<  unsigned int> { };
+template<> struct TextSender<          long> : public IntTextSender<          long> { };
+template<> struct TextSender< unsigned long> : public IntTextSender< unsigned long> { };
+template<> struct TextSender<     long long> : public IntTextSender<     long long> { };
+template<> struct TextSender<unsigned long long> : public IntTextSender<unsigned long long> { };
+
 // Make char types print as integers, not as characters.
 template <typename T>
 struct CastIntTextSender {
     static void send(std::ostream &stream, const T &v) {
-        stream << static_cast<int>(v);
+        TextSender<int>::send(stream, static_cast<int>(v));
     }
 };
 template<> struct TextSender<          char> : public CastIntTextSender<          char> { };
@@ -498,10 +862,41 @@ template<> struct TextSender<   signed char> : public CastIntTextSender<   signe
 template<> struct TextSender< unsigned char> : public CastIntTextSender< unsigned char> { };
 
 // Make sure that the same not-a-number string is printed on all platforms.
+//
+// In the default float format, if the stream's precision is enough to round-trip the value
+// (this is the case for the Gnuplot class, which sets a precision of 17) then the shortest
+// representation that round-trips is printed.  For example, 0.1 is printed as "0.1" rather than
+// "0.10000000000000001".  Otherwise the output is the same as `<<` would give.
 template <typename T>
 struct FloatTextSender {
     static void send(std::ostream &stream, const T &v) {
-        if(std::isnan(v)) { stream << "nan"; } else { stream << v; }
+        if(std::isnan(v)) { stream << "nan"; return; }
+#ifdef GNUPLOT_HAVE_FLOAT_TO_CHARS
+        if(to_chars_can_format(stream)) {
+            // Large enough for any value in the default or scientific formats.  In the fixed
+            // format huge values may not fit, in which case we fall back to `<<`.
+            char buf[128];
+            const std::streamsize prec = stream.precision();
+            const std::ios_base::fmtflags floatfield = stream.flags() & std::ios_base::floatfield;
+            std::to_chars_result res{buf, std::errc::not_supported}; // for hexfloat
+            if(floatfield == std::ios_base::fixed) {
+                res = std::to_chars(buf, buf + sizeof(buf), v, std::chars_format::fixed, prec);
+            } else if(floatfield == std::ios_base::scientific) {
+                res = std::to_chars(buf, buf + sizeof(buf), v, std::chars_format::scientific, prec);
+            } else if(floatfield == std::ios_base::fmtflags(0)) {
+                if(prec >= std::numeric_limits<T>::max_digits10) {
+                    res = std::to_chars(buf, buf + sizeof(buf), v);
+                } else {
+                    res = std::to_chars(buf, buf + sizeof(buf), v, std::chars_format::general, prec);
+                }
+            }
+            if(res.ec == std::errc()) {
+                stream.write(buf, res.ptr - buf);
+                return;
+            }
+        }
+#endif // GNUPLOT_HAVE_FLOAT_TO_CHARS
+        stream << v;
     }
 };
 template<> struct TextSender<      float> : FloatTextSender<      float> { };
@@ -537,6 +932,17 @@ struct BinarySender<std::pair<T, U>> {
     }
 };
 
+template <typename T, typename U>
+struct FlatBinaryLayout<std::pair<T, U>> {
+    static constexpr bool is_flat = FlatBinaryLayout<T>::is_flat && FlatBinaryLayout<U>::is_flat;
+
+    static bool matches_at(const std::pair<T, U> &v, const char *base, size_t &offset) {
+        bool ret = FlatBinaryLayout<T>::matches_at(v.first, base, offset);
+        ret = FlatBinaryLayout<U>::matches_at(v.second, base, offset) && ret;
+        return ret;
+    }
+};
+
 // }}}2
 
 // {{{2 std::complex support
@@ -566,6 +972,18 @@ struct BinarySender<std::complex<T>> {
     }
 };
 
+// std::complex is guaranteed to be stored as an array of two elements (real then imaginary).
+template <typename T>
+struct FlatBinaryLayout<std::complex<T>> {
+    static constexpr bool is_flat = FlatBinaryLayout<T>::is_flat;
+
+    static bool matches_at(const std::complex<T> &v, const char *base, size_t &offset) {
+        bool ret = (reinterpret_cast<const char *>(&v) == base + offset);
+        offset += sizeof(std::complex<T>);
+        return ret && sizeof(std::complex<T>) == 2*sizeof(T);
+    }
+};
+
 // }}}2
 
 // {{{2 boost::tuple support
@@ -678,6 +1096,119 @@ struct BinarySender<std::tuple<Args...>> {
     }
 };
 
+template <typename... Args>
+struct FlatBinaryLayout<std::tuple<Args...>> {
+    typedef typename std::tuple<Args...> Tuple;
+
+    static constexpr bool is_flat = (FlatBinaryLayout<Args>::is_flat && ...);
+
+    static bool matches_at(const Tuple &v, const char *base, size_t &offset) {
+        return matches_helper(v, base, offset, std::index_sequence_for<Args...>());
+    }
+
+private:
+    template <size_t... I>
+    static bool matches_helper(const Tuple &v, const char *base, size_t &offset, std::index_sequence<I...>) {
+        bool ret = true;
+        // The comma operator guarantees left to right evaluation, so that the offset is
+        // advanced in the same order that BinarySender sends the elements.
+        ((ret = FlatBinaryLayout<Args>::matches_at(std::get<I>(v), base, offset) && ret), ...);
+        return ret;
+    }
+};
+
+// }}}2
+
+// {{{2 Conversion to single precision
+//
+// Gnuplot doesn't need more than single precision to draw a plot, so sending floats rather than
+// doubles halves the amount of binary data (see `as_float()`).  DowncastValue gives the single
+// precision version of an entry datatype.  Types that aren't double precision are unchanged.
+
+template <typename T, typename=void>
+struct DowncastValue {
+    typedef T type;
+    static const T &apply(const T &v) { return v; }
+};
+
+template <>
+struct DowncastValue<double> {
+    typedef float type;
+    static float apply(double v) { return static_cast<float>(v); }
+};
+
+template <>
+struct DowncastValue<long double> {
+    typedef float type;
+    static float apply(long double v) { return static_cast<float>(v); }
+};
+
+template <typename T>
+struct DowncastValue<std::complex<T>> {
+    typedef std::complex<typename DowncastValue<T>::type> type;
+    static type apply(const std::complex<T> &v) {
+        return type(DowncastValue<T>::apply(v.real()), DowncastValue<T>::apply(v.imag()));
+    }
+};
+
+template <typename T, typename U>
+struct DowncastValue<std::pair<T, U>> {
+    typedef std::pair<typename DowncastValue<T>::type, typename DowncastValue<U>::type> type;
+    static type apply(const std::pair<T, U> &v) {
+        return type(DowncastValue<T>::apply(v.first), DowncastValue<U>::apply(v.second));
+    }
+};
+
+template <typename... Args>
+struct DowncastValue<std::tuple<Args...>> {
+    typedef std::tuple<typename DowncastValue<Args>::type...> type;
+    static type apply(const std::tuple<Args...> &v) {
+        return std::apply([](const Args &... x) { return type(DowncastValue<Args>::apply(x)...); }, v);
+    }
+};
+
+// A boost::tuple is converted to the cons list that it is built from, which is sent the same
+// way (see is_boost_tuple).
+template <typename T>
+struct DowncastValue<T, std::enable_if_t<is_boost_tuple<T>>> {
+    typedef typename DowncastValue<typename T::head_type>::type head_type;
+    typedef typename DowncastValue<typename T::tail_type>::type tail_type;
+    typedef boost::tuples::cons<head_type, tail_type> type;
+    static type apply(const T &v) {
+        return type(
+            DowncastValue<typename T::head_type>::apply(v.get_head()),
+            DowncastValue<typename T::tail_type>::apply(v.get_tail()));
+    }
+};
+
+// Converts `n` entries at once.
+template <typename T>
+void downcast_run(const T *src, typename DowncastValue<T>::type *dst, size_t n) {
+    for(size_t i=0; i<n; i++) {
+        dst[i] = DowncastValue<T>::apply(src[i]);
+    }
+}
+
+// The common case of plain doubles uses SIMD instructions where available.  The result is the
+// same as static_cast (round to nearest).
+inline void downcast_run(const double *src, float *dst, size_t n) {
+    size_t i = 0;
+#if defined(__AVX__)
+    for(; i+4 <= n; i += 4) {
+        _mm_storeu_ps(dst+i, _mm256_cvtpd_ps(_mm256_loadu_pd(src+i)));
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    for(; i+4 <= n; i += 4) {
+        const __m128 lo = _mm_cvtpd_ps(_mm_loadu_pd(src+i));
+        const __m128 hi = _mm_cvtpd_ps(_mm_loadu_pd(src+i+2));
+        _mm_storeu_ps(dst+i, _mm_movelh_ps(lo, hi));
+    }
+#endif
+    for(; i<n; i++) {
+        dst[i] = static_cast<float>(src[i]);
+    }
+}
+
 // }}}2
 
 // }}}1
@@ -725,7 +1256,8 @@ struct BinarySender<std::tuple<Args...>> {
 // returns the value of the entry the iterator points to (a scalar, pair, or tuple).
 // Only one of `deref()` or `deref_subiter()` will be available, depending on whether there are
 // deeper levels of nesting.  The typedefs `value_type` and `subiter_type` tell the return
-// types of these two methods.
+// types of these two methods.  Ranges that can cheaply tell how many elements remain may
+// provide a `size()` method; otherwise the size is found by counting (see get_range_size()).
 //
 // Support for standard C++ and boost containers and tuples of containers is provided in this
 // section.  Support for third party packages like Blitz and Armadillo is in a later section.
@@ -780,10 +1312,37 @@ public:
     static constexpr size_t depth = ArrayTraits<V>::depth + 1;
 };
 
+// Tells whether a range has a `size()` method, giving the number of elements remaining.
+template <typename T, typename=void>
+static constexpr bool has_range_size = false;
+
+template <typename T>
+static constexpr bool has_range_size<T, std::void_t<
+        decltype(std::declval<const T &>().size())
+    >> = true;
+
 // }}}2
 
 // {{{2 STL container support
 
+// Tells whether an iterator of type TI points to elements (of type TV) that are stored
+// contiguously in memory.  This is only needed for element types that can be sent in bulk (see
+// FlatBinaryLayout).  It is conservative: iterators of other contiguous containers just take
+// the slower, element by element, path.
+template <typename TI, typename TV, typename=void>
+static constexpr bool is_contiguous_iterator = std::is_pointer_v<TI>;
+
+template <typename TI, typename TV>
+static constexpr bool is_contiguous_iterator<TI, TV, std::enable_if_t<
+        FlatBinaryLayout<TV>::is_flat && !std::is_pointer_v<TI>
+    >> =
+    std::is_same_v<TI, typename std::vector<TV>::const_iterator> ||
+    std::is_same_v<TI, typename std::vector<TV>::iterator>;
+
+static_assert( is_contiguous_iterator<const double *, double>);
+static_assert( is_contiguous_iterator<std::vector<double>::const_iterator, double>);
+static_assert(!is_contiguous_iterator<std::vector<std::vector<double>>::const_iterator, std::vector<double>>);
+
 template <typename TI, typename TV>
 class IteratorRange {
 public:
@@ -791,6 +1350,9 @@ public:
     IteratorRange(const TI &_it, const TI &_end) : it(_it), end(_end) { }
 
     static constexpr bool is_container = ArrayTraits<TV>::is_container;
+    // Whether the elements are stored contiguously in memory, allowing `contiguous_data()` to
+    // be used for sending all elements at once.
+    static constexpr bool is_contiguous = is_contiguous_iterator<TI, TV>;
 
     // Error messages involving this stem from calling deref instead of deref_subiter for a nested
     // container.
@@ -803,6 +1365,12 @@ public:
 
     void inc() { ++it; }
 
+    // Only available for random access iterators.
+    template <typename I=TI>
+    typename std::enable_if_t<std::is_base_of_v<std::random_access_iterator_tag,
+        typename std::iterator_traits<I>::iterator_category>, size_t>
+    size() const { return static_cast<size_t>(end - it); }
+
     value_type deref() const {
         static_assert(sizeof(TV) && !is_container,
             "deref called on nested container");
@@ -821,6 +1389,14 @@ public:
         return ArrayTraits<TV>::get_range(*it);
     }
 
+    // Pointer to the current element.  Only available if `is_contiguous`.  Must not be called
+    // when `is_end()`.
+    const TV *contiguous_data() const {
+        static_assert(sizeof(TV) && is_contiguous,
+            "contiguous_data called on non-contiguous range");
+        return &*it;
+    }
+
 private:
     TI it, end;
 };
@@ -869,10 +1445,17 @@ public:
 
 // {{{2 std::pair support
 
+template <typename R, typename=void>
+struct InterleaveColumns;
+
 template <typename RT, typename RU>
 class PairOfRange {
     template <typename T, typename U, typename PrintMode>
     friend void deref_and_print(std::ostream &, const PairOfRange<T, U> &, PrintMode);
+    template <typename R>
+    friend struct FloatRangeMap;
+    template <typename R, typename E>
+    friend struct InterleaveColumns;
 
 public:
     PairOfRange() { }
@@ -897,6 +1480,17 @@ public:
         r.inc();
     }
 
+    // Only available if both children have a size() method.
+    template <typename L=RT, typename R=RU>
+    typename std::enable_if_t<has_range_size<L> && has_range_size<R>, size_t>
+    size() const {
+        size_t sl = l.size();
+        if(sl != r.size()) {
+            throw std::length_error("columns were different lengths");
+        }
+        return sl;
+    }
+
     value_type deref() const {
         return std::make_pair(l.deref(), r.deref());
     }
@@ -1032,10 +1626,15 @@ template <typename RT>
 class VecOfRange {
     template <typename T, typename PrintMode>
     friend void deref_and_print(std::ostream &, const VecOfRange<T> &, PrintMode);
+    template <typename R>
+    friend struct FloatRangeMap;
+    template <typename R>
+    friend class VecOfRange;
 
 public:
     VecOfRange() { }
     explicit VecOfRange(const std::vector<RT> &_rvec) : rvec(_rvec) { }
+    explicit VecOfRange(std::vector<RT> &&_rvec) : rvec(std::move(_rvec)) { }
 
     static constexpr bool is_container = RT::is_container;
     // Don't allow colwrap since it's already wrapped.
@@ -1061,6 +1660,20 @@ public:
         }
     }
 
+    // Only available if the children have a size() method.
+    template <typename R=RT>
+    typename std::enable_if_t<has_range_size<R>, size_t>
+    size() const {
+        if(rvec.empty()) return 0;
+        size_t ret = rvec[0].size();
+        for(size_t i=1; i<rvec.size(); i++) {
+            if(ret != rvec[i].size()) {
+                throw std::length_error("columns were different lengths");
+            }
+        }
+        return ret;
+    }
+
     value_type deref() const {
         value_type ret(rvec.size());
         for(size_t i=0; i<rvec.size(); i++) {
@@ -1074,7 +1687,16 @@ public:
         for(size_t i=0; i<rvec.size(); i++) {
             subvec[i] = rvec[i].deref_subiter();
         }
-        return subiter_type(subvec);
+        return subiter_type(std::move(subvec));
+    }
+
+    // Same as `out = deref_subiter()`, but reuses the memory of `out`.  print_block() uses this
+    // so that sending N blocks doesn't cost N allocations (see assign_subiter()).
+    void deref_subiter_into(subiter_type &out) const {
+        out.rvec.resize(rvec.size());
+        for(size_t i=0; i<rvec.size(); i++) {
+            out.rvec[i] = rvec[i].deref_subiter();
+        }
     }
 
 private:
@@ -1087,12 +1709,14 @@ get_columns_range(const T &arg) {
     typedef typename ArrayTraits<T>::range_type::subiter_type U;
     std::vector<U> rvec;
     typename ArrayTraits<T>::range_type outer = ArrayTraits<T>::get_range(arg);
+    if constexpr (has_range_size<typename ArrayTraits<T>::range_type>) {
+        rvec.reserve(outer.size());
+    }
     while(!outer.is_end()) {
         rvec.push_back(outer.deref_subiter());
         outer.inc();
     }
-    VecOfRange<U> ret(rvec);
-    return ret;
+    return VecOfRange<U>(std::move(rvec));
 }
 
 // }}}2
@@ -1111,6 +1735,43 @@ get_columns_range(const T &arg) {
 // puts brackets around groups of items and puts a message delineating blocks of data.
 static bool debug_array_print = 0;
 
+// Text-mode data is terminated with plain newlines rather than `std::endl`, so that the stream
+// is only flushed once at the end of a send rather than after every line (each flush of the
+// pipe to gnuplot is a separate `write()` system call).  If this is set, then the stream is
+// flushed after every line, which can help when debugging a gnuplot session that hangs midway
+// through receiving data.
+static bool debug_flush_each_line = 0;
+
+// Text-mode formatting of long 1D data can be split across threads.  Chunks of rows are
+// formatted concurrently into separate buffers, and then written in order, so the output is the
+// same as with a single thread.  The number of threads is set per stream (Gnuplot::setTextThreads
+// sets it for a Gnuplot object and for files it writes), falling back to this default for
+// other streams (e.g. the buffers of PlotGroup).
+inline unsigned default_text_format_threads = 1;
+
+// Runs all of the given tasks and returns once they are done.  If this is not set, threads are
+// started at the beginning of each send and reused for all of its chunks, with one task run on
+// the calling thread.  Set this to use an existing thread pool instead.
+inline std::function<void(const std::vector<std::function<void()>> &)> text_format_executor;
+
+// The chunk of rows formatted by each task.  Data with fewer than two chunks is formatted on
+// the calling thread.
+inline size_t text_format_chunk_rows = 16384;
+
+inline int text_format_threads_index() {
+    static const int index = std::ios_base::xalloc();
+    return index;
+}
+
+inline void set_text_format_threads(std::ostream &stream, unsigned num_threads) {
+    stream.iword(text_format_threads_index()) = num_threads;
+}
+
+inline unsigned get_text_format_threads(std::ostream &stream) {
+    long n = stream.iword(text_format_threads_index());
+    return n > 0 ? static_cast<unsigned>(n) : default_text_format_threads;
+}
+
 // This is thrown when an empty container is being plotted.  This exception should always
 // be caught and should not propagate to the user.
 class plotting_empty_container : public std::length_error {
@@ -1128,10 +1789,10 @@ public:
 // ModeBinary - Sends the data in an array in binary format
 // ModeBinfmt - Sends the gnuplot format code for binary data (e.g. "%double%double")
 // ModeSize   - Sends the size of an array.  Needed when sending binary data.
-struct ModeText   { static constexpr bool is_text = 1; static constexpr bool is_binfmt = 0; static constexpr bool is_size = 0; };
-struct ModeBinary { static constexpr bool is_text = 0; static constexpr bool is_binfmt = 0; static constexpr bool is_size = 0; };
-struct ModeBinfmt { static constexpr bool is_text = 0; static constexpr bool is_binfmt = 1; static constexpr bool is_size = 0; };
-struct ModeSize   { static constexpr bool is_text = 0; static constexpr bool is_binfmt = 0; static constexpr bool is_size = 1; };
+struct ModeText   { static constexpr bool is_text = 1; static constexpr bool is_binary = 0; static constexpr bool is_binfmt = 0; static constexpr bool is_size = 0; };
+struct ModeBinary { static constexpr bool is_text = 0; static constexpr bool is_binary = 1; static constexpr bool is_binfmt = 0; static constexpr bool is_size = 0; };
+struct ModeBinfmt { static constexpr bool is_text = 0; static constexpr bool is_binary = 0; static constexpr bool is_binfmt = 1; static constexpr bool is_size = 0; };
+struct ModeSize   { static constexpr bool is_text = 0; static constexpr bool is_binary = 0; static constexpr bool is_binfmt = 0; static constexpr bool is_size = 1; };
 
 // Whether to treat the outermost level of a nested container as columns (column major mode).
 struct ColUnwrapNo  { };
@@ -1309,73 +1970,559 @@ void deref_and_print(std::ostream &stream, const VecOfRange<T> &arg, PrintMode)
 // the future (e.g. volume rendering), all that would be needed would be some trivial changes
 // in this section.  After Depth number of nested containers have been recursed into, control
 // is passed to deref_and_print(), which treats any further nested containers as columns.
+//
+// When sending data or the format string, print_block() returns the shape of the array: the
+// number of elements at each nesting level, with the fastest varying index first (i.e. the
+// same order used by ModeSize).  Only the first block is looked at when determining the size of
+// inner levels.  This allows the size to be determined in the same pass that sends the data.
 
-// Depth==1 and we are not asked to print the size of the array.  Send each element of the
-// range to deref_and_print() for further processing into columns.
-template <size_t Depth, typename T, typename PrintMode>
-typename std::enable_if_t<(Depth==1) && !PrintMode::is_size>
-print_block(std::ostream &stream, T &arg, PrintMode) {
-    if(PrintMode::is_binfmt && arg.is_end()) throw plotting_empty_container();
-    for(; !arg.is_end(); arg.inc()) {
-        //print_entry(arg.deref());
-        deref_and_print(stream, arg, PrintMode());
-        // If asked to print the binary format string, only the first element needs to be
-        // looked at.
-        if(PrintMode::is_binfmt) break;
-        if(PrintMode::is_text) stream << std::endl;
+// Determine how many elements are in the given range.  Used in the functions below.
+template <typename T>
+size_t get_range_size(const T &arg) {
+    if constexpr (has_range_size<T>) {
+        return arg.size();
+    } else {
+        size_t ret = 0;
+        for(T i=arg; !i.is_end(); i.inc()) ++ret;
+        return ret;
     }
 }
 
-// Depth>1 and we are not asked to print the size of the array.  Loop over the range and
-// recurse into print_block() with Depth -> Depth-1.
-template <size_t Depth, typename T, typename PrintMode>
-typename std::enable_if_t<(Depth>1) && !PrintMode::is_size>
-print_block(std::ostream &stream, T &arg, PrintMode) {
-    if(PrintMode::is_binfmt && arg.is_end()) throw plotting_empty_container();
-    bool first = true;
-    for(; !arg.is_end(); arg.inc()) {
-        if(first) {
-            first = false;
-        } else {
-            if(PrintMode::is_text) stream << std::endl;
-        }
-        if(debug_array_print && PrintMode::is_text) stream << "<block>" << std::endl;
-        if(arg.is_end()) throw plotting_empty_container();
-        typename T::subiter_type sub = arg.deref_subiter();
-        print_block<Depth-1>(stream, sub, PrintMode());
-        // If asked to print the binary format string, only the first element needs to be
-        // looked at.
-        if(PrintMode::is_binfmt) break;
-    }
-}
+// Ranges over elements stored contiguously in memory, with a flat binary layout, can be sent in
+// binary mode using a single write.  Such ranges define `is_contiguous` and provide a
+// `contiguous_data()` method.
+template <typename T, typename=void>
+static constexpr bool is_contiguous_range = false;
 
-// Determine how many elements are in the given range.  Used in the functions below.
 template <typename T>
-size_t get_range_size(const T &arg) {
-    // FIXME - not the fastest way.  Implement a size() method for range.
-    size_t ret = 0;
-    for(T i=arg; !i.is_end(); i.inc()) ++ret;
-    return ret;
-}
+static constexpr bool is_contiguous_range<T, std::enable_if_t<T::is_contiguous>> =
+    !T::is_container && FlatBinaryLayout<typename T::value_type>::is_flat;
 
-// Depth==1 and we are asked to print the size of the array.
-template <size_t Depth, typename T, typename PrintMode>
-typename std::enable_if_t<(Depth==1) && PrintMode::is_size>
-print_block(std::ostream &stream, T &arg, PrintMode) {
-    stream << get_range_size(arg);
+// Send the whole range with one write, storing the number of elements sent in `num`.  Returns
+// false, without sending anything, if the memory layout turned out to not be what gnuplot
+// expects.  In that case the caller should fall back to sending element by element.
+template <typename T>
+bool send_contiguous_binary(std::ostream &stream, const T &arg, size_t &num) {
+    num = 0;
+    if(arg.is_end()) return true;
+    const typename T::value_type *p = arg.contiguous_data();
+    if(!p || !has_flat_binary_layout(*p)) return false;
+    num = get_range_size(arg);
+    stream.write(reinterpret_cast<const char *>(p),
+        static_cast<std::streamsize>(num * sizeof(*p)));
+    return true;
 }
 
-// Depth>1 and we are asked to print the size of the array.
-template <size_t Depth, typename T, typename PrintMode>
-typename std::enable_if_t<(Depth>1) && PrintMode::is_size>
-print_block(std::ostream &stream, T &arg, PrintMode) {
-    if(arg.is_end()) throw plotting_empty_container();
-    // It seems that size for two dimensional arrays needs the fastest varying index first,
-    // contrary to intuition.  The gnuplot documentation is not too clear on this point.
-    typename T::subiter_type sub = arg.deref_subiter();
-    print_block<Depth-1>(stream, sub, PrintMode());
-    stream << "," << get_range_size(arg);
-}
+// Describes all of the remaining elements of a (nested) range, in the order they would be sent,
+// as a three level strided array: element (i, j, k) is at `base[i*stride[0] + j*stride[1] +
+// k*stride[2]]`, with `i` being the outermost level.  Ranges over strided storage (such as
+// Armadillo's column major matrices) can provide a `strided_block()` method returning this, in
+// order to be sent in binary mode with send_strided_binary() rather than element by element.
+//
+// If `Out` differs from `T`, the elements are converted with DowncastValue on the way out.
+template <typename T, typename Out=T>
+struct StridedBlock {
+    typedef T value_type;
+    typedef Out out_type;
+    const T *base;
+    std::array<size_t, 3> n;
+    std::array<ptrdiff_t, 3> stride;
+};
+
+template <typename T, typename=void>
+static constexpr bool has_strided_block = false;
+
+template <typename T>
+static constexpr bool has_strided_block<T, std::void_t<
+        decltype(std::declval<const T &>().strided_block())
+    >> = FlatBinaryLayout<typename decltype(std::declval<const T &>().strided_block())::value_type>::is_flat &&
+         FlatBinaryLayout<typename decltype(std::declval<const T &>().strided_block())::out_type>::is_flat;
+
+// Writes a StridedBlock in the order (i, j, k), with the last index varying fastest.  If that is
+// how the elements are laid out in memory this is a single write.  Otherwise elements are
+// gathered into a scratch buffer a band of `i` values at a time, with `i` in the innermost loop,
+// so that storage where `i` is the fastest varying index in memory (e.g. column major) is read
+// sequentially.  The bytes written are the same as sending the elements one at a time.
+template <typename T, typename Out>
+void send_strided_binary(std::ostream &stream, const StridedBlock<T, Out> &b) {
+    const size_t n0 = b.n[0], n1 = b.n[1], n2 = b.n[2];
+    const ptrdiff_t s0 = b.stride[0], s1 = b.stride[1], s2 = b.stride[2];
+    const size_t row = n1 * n2;
+    if(!n0 || !row) return;
+
+    const auto write = [&](const Out *p, size_t num) {
+        stream.write(reinterpret_cast<const char *>(p), static_cast<std::streamsize>(num * sizeof(Out)));
+    };
+
+    if((n2 == 1 || s2 == 1) && (n1 == 1 || s1 == static_cast<ptrdiff_t>(n2))) {
+        // Each `i` is a contiguous run.
+        const bool one_run = (n0 == 1 || s0 == static_cast<ptrdiff_t>(row));
+        if constexpr (std::is_same_v<T, Out>) {
+            if(one_run) {
+                write(b.base, n0 * row);
+            } else {
+                for(size_t i=0; i<n0; i++) write(b.base + i*s0, row);
+            }
+        } else {
+            // Convert in chunks that fit in cache.
+            const size_t chunk = 1 << 14;
+            std::vector<Out> scratch(chunk);
+            const auto convert_run = [&](const T *p, size_t num) {
+                for(size_t done=0; done<num; done+=chunk) {
+                    const size_t m = std::min(chunk, num - done);
+                    downcast_run(p + done, scratch.data(), m);
+                    write(scratch.data(), m);
+                }
+            };
+            if(one_run) {
+                convert_run(b.base, n0 * row);
+            } else {
+                for(size_t i=0; i<n0; i++) convert_run(b.base + i*s0, row);
+            }
+        }
+        return;
+    }
+
+    // Keep the scratch buffer around 1MB, and the band small enough that the rows being filled
+    // stay in cache.
+    const size_t band = std::max<size_t>(1, std::min<size_t>(64, (1 << 20) / (row * sizeof(Out))));
+    std::vector<Out> scratch(band * row);
+    for(size_t i0=0; i0<n0; i0+=band) {
+        const size_t bn = std::min(band, n0 - i0);
+        const T *p0 = b.base + static_cast<ptrdiff_t>(i0) * s0;
+        for(size_t j=0; j<n1; j++) {
+            for(size_t k=0; k<n2; k++) {
+                const T *p = p0 + static_cast<ptrdiff_t>(j) * s1 + static_cast<ptrdiff_t>(k) * s2;
+                Out *q = scratch.data() + j*n2 + k;
+                for(size_t i=0; i<bn; i++) {
+                    if constexpr (std::is_same_v<T, Out>) {
+                        q[i*row] = p[static_cast<ptrdiff_t>(i) * s0];
+                    } else {
+                        q[i*row] = DowncastValue<T>::apply(p[static_cast<ptrdiff_t>(i) * s0]);
+                    }
+                }
+            }
+        }
+        write(scratch.data(), bn * row);
+    }
+}
+
+// If the range supports it, sends the whole thing with send_strided_binary() and fills in
+// `shape` (see print_block() for its format).  Returns false, without sending anything, if
+// this can't be done.
+template <size_t Depth, typename T>
+bool send_strided_block(std::ostream &stream, const T &arg, std::array<size_t, Depth> &shape) {
+    static_assert(Depth <= 3);
+    const auto b = arg.strided_block();
+    typedef typename decltype(b)::out_type Out;
+    if(!b.base || !b.n[0] || !b.n[1] || !b.n[2]) return false;
+    if(!has_flat_binary_layout(*b.base)) return false;
+    if constexpr (!std::is_same_v<typename decltype(b)::value_type, Out>) {
+        if(!has_flat_binary_layout(Out(DowncastValue<typename decltype(b)::value_type>::apply(*b.base)))) return false;
+    }
+    send_strided_binary(stream, b);
+    for(size_t d=0; d<Depth; d++) shape[d] = b.n[Depth-1-d];
+    return true;
+}
+
+// One column of a struct-of-arrays range (a tree of PairOfRange, e.g. from a tuple of vectors),
+// described by InterleaveColumns so that send_interleaved_binary() can copy it directly.
+struct InterleaveColumn {
+    const void *base;
+    // Distance between elements, in elements.
+    ptrdiff_t stride;
+    size_t size;
+    // Size of an element in the output.
+    size_t out_size;
+    // Whether this is contiguous doubles sent as doubles (handled by interleave_doubles()).
+    bool plain_double;
+    // Copies `num` elements starting at `first` to `dst`, `record` bytes apart.
+    void (*gather)(const InterleaveColumn &col, size_t first, size_t num, char *dst, size_t record);
+};
+
+template <typename T, typename Out>
+void gather_interleave_column(const InterleaveColumn &col, size_t first, size_t num, char *dst, size_t record) {
+    const T *p = static_cast<const T *>(col.base) + static_cast<ptrdiff_t>(first) * col.stride;
+    for(size_t i=0; i<num; i++, p += col.stride, dst += record) {
+        if constexpr (std::is_same_v<T, Out>) {
+            std::memcpy(dst, p, sizeof(Out));
+        } else {
+            const Out v = DowncastValue<T>::apply(*p);
+            std::memcpy(dst, &v, sizeof(Out));
+        }
+    }
+}
+
+// The common case of K columns of doubles.  With K known at compile time the compiler can turn
+// this into shuffles.
+template <size_t K>
+void interleave_doubles(const InterleaveColumn *cols, size_t first, size_t num, double *dst) {
+    const double *src[K];
+    for(size_t k=0; k<K; k++) src[k] = static_cast<const double *>(cols[k].base) + first;
+    for(size_t i=0; i<num; i++) {
+        for(size_t k=0; k<K; k++) {
+            dst[i*K + k] = src[k][i];
+        }
+    }
+}
+
+// Lists the columns of a range, if it is a tree of PairOfRange whose leaves are 1D ranges over
+// memory with a flat binary layout.  `is_tree` tells whether T is such a tree, at compile time.
+// collect() returns false if the memory layout turns out to not be usable.
+template <typename R, typename>
+struct InterleaveColumns {
+    static constexpr bool is_leaf = false;
+    static constexpr bool is_tree = false;
+};
+
+template <typename R>
+struct InterleaveColumns<R, std::enable_if_t<!R::is_container && (is_contiguous_range<R> || has_strided_block<R>)>> {
+    static constexpr bool is_leaf = true;
+    static constexpr bool is_tree = false;
+
+    static bool collect(const R &r, std::vector<InterleaveColumn> &cols) {
+        if constexpr (is_contiguous_range<R>) {
+            typedef typename R::value_type T;
+            if(r.is_end()) {
+                cols.push_back(InterleaveColumn{nullptr, 1, 0, sizeof(T), false, &gather_interleave_column<T, T>});
+                return true;
+            }
+            const T *p = r.contiguous_data();
+            if(p && has_flat_binary_layout(*p)) {
+                cols.push_back(InterleaveColumn{p, 1, get_range_size(r), sizeof(T),
+                    std::is_same_v<T, double>, &gather_interleave_column<T, T>});
+                return true;
+            }
+        }
+        if constexpr (has_strided_block<R>) {
+            const auto b = r.strided_block();
+            typedef typename decltype(b)::value_type T;
+            typedef typename decltype(b)::out_type Out;
+            if(!b.base || !b.n[0]) {
+                cols.push_back(InterleaveColumn{nullptr, 1, 0, sizeof(Out), false, &gather_interleave_column<T, Out>});
+                return true;
+            }
+            if(b.n[1] != 1 || b.n[2] != 1) return false;
+            if(!has_flat_binary_layout(*b.base)) return false;
+            if constexpr (!std::is_same_v<T, Out>) {
+                if(!has_flat_binary_layout(Out(DowncastValue<T>::apply(*b.base)))) return false;
+            }
+            cols.push_back(InterleaveColumn{b.base, b.stride[0], b.n[0], sizeof(Out),
+                std::is_same_v<T, double> && std::is_same_v<Out, double> && b.stride[0] == 1,
+                &gather_interleave_column<T, Out>});
+            return true;
+        }
+        return false;
+    }
+};
+
+template <typename RT, typename RU>
+struct InterleaveColumns<PairOfRange<RT, RU>> {
+    static constexpr bool is_leaf = false;
+    static constexpr bool is_tree =
+        (InterleaveColumns<RT>::is_leaf || InterleaveColumns<RT>::is_tree) &&
+        (InterleaveColumns<RU>::is_leaf || InterleaveColumns<RU>::is_tree);
+
+    static bool collect(const PairOfRange<RT, RU> &r, std::vector<InterleaveColumn> &cols) {
+        return InterleaveColumns<RT>::collect(r.l, cols) && InterleaveColumns<RU>::collect(r.r, cols);
+    }
+};
+
+// Sends a struct-of-arrays range (see InterleaveColumns) in binary mode by gathering the columns
+// into records a block at a time and writing each block at once, storing the number of records
+// in `num`.  The lengths are checked once, up front.  Returns false, having sent nothing, if the
+// columns can't be accessed directly.
+template <typename T>
+bool send_interleaved_binary(std::ostream &stream, const T &arg, size_t &num) {
+    std::vector<InterleaveColumn> cols;
+    if(!InterleaveColumns<T>::collect(arg, cols)) return false;
+
+    num = cols[0].size;
+    size_t record = 0;
+    bool plain_doubles = true;
+    for(const InterleaveColumn &c : cols) {
+        if(c.size != num) {
+            throw std::length_error("columns were different lengths");
+        }
+        record += c.out_size;
+        plain_doubles = plain_doubles && c.plain_double;
+    }
+    if(!num) return true;
+
+    // Blocks of about 32KB stay in cache between being filled and being written.
+    const size_t block = std::max<size_t>(1, (1 << 15) / record);
+    std::vector<double> scratch((block * record + sizeof(double) - 1) / sizeof(double));
+    char *buf = reinterpret_cast<char *>(scratch.data());
+    for(size_t first=0; first<num; first+=block) {
+        const size_t m = std::min(block, num - first);
+        if(plain_doubles && cols.size() == 2) {
+            interleave_doubles<2>(cols.data(), first, m, scratch.data());
+        } else if(plain_doubles && cols.size() == 3) {
+            interleave_doubles<3>(cols.data(), first, m, scratch.data());
+        } else if(plain_doubles && cols.size() == 4) {
+            interleave_doubles<4>(cols.data(), first, m, scratch.data());
+        } else {
+            size_t offset = 0;
+            for(const InterleaveColumn &c : cols) {
+                c.gather(c, first, m, buf + offset, record);
+                offset += c.out_size;
+            }
+        }
+        stream.write(buf, static_cast<std::streamsize>(m * record));
+    }
+    return true;
+}
+
+// Threads that run batches of tasks, used by send_text_parallel() when no text_format_executor
+// is set.  The threads are started once and then reused for each batch.
+class TextFormatThreads {
+public:
+    explicit TextFormatThreads(size_t num_threads) {
+        try {
+            for(size_t i=0; i<num_threads; i++) {
+                threads.emplace_back([this, i]() { work(i); });
+            }
+        } catch(...) {
+            stop();
+            throw;
+        }
+    }
+
+private:
+    // noncopyable
+    TextFormatThreads(const TextFormatThreads &) = delete;
+    const TextFormatThreads& operator=(const TextFormatThreads &) = delete;
+
+public:
+    ~TextFormatThreads() {
+        stop();
+    }
+
+    // Runs tasks[i] on thread i, and any tasks beyond the number of threads on the calling
+    // thread.  Returns once all of them are done.
+    void run(const std::vector<std::function<void()>> &tasks) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            batch = &tasks;
+            batch_size = tasks.size();
+            pending = std::min(tasks.size(), threads.size());
+            ++generation;
+        }
+        cond.notify_all();
+        for(size_t i=threads.size(); i<tasks.size(); i++) tasks[i]();
+        std::unique_lock<std::mutex> lock(mutex);
+        done_cond.wait(lock, [this]() { return pending == 0; });
+    }
+
+private:
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        cond.notify_all();
+        for(std::thread &th : threads) th.join();
+    }
+
+    void work(size_t i) {
+        size_t seen = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        for(;;) {
+            cond.wait(lock, [&]() { return stopping || generation != seen; });
+            if(stopping) return;
+            seen = generation;
+            // Only a task that run() is waiting for may be looked at, since `batch` is gone
+            // once run() returns.
+            if(i < batch_size) {
+                const std::function<void()> &task = (*batch)[i];
+                lock.unlock();
+                task();
+                lock.lock();
+                if(--pending == 0) done_cond.notify_all();
+            }
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::condition_variable done_cond;
+    const std::vector<std::function<void()>> *batch = nullptr;
+    size_t batch_size = 0;
+    size_t pending = 0;
+    size_t generation = 0;
+    bool stopping = false;
+    // Must come last, so that everything above is initialized before the threads start.
+    std::vector<std::thread> threads;
+};
+
+// Sends the rows of a 1D range in text mode, formatting chunks of rows on several threads (see
+// default_text_format_threads).  The output is the same as that of print_block().  Returns
+// false, having sent nothing, if the data is too small to be worth splitting up.
+template <typename T, typename PrintMode>
+bool send_text_parallel(std::ostream &stream, T &arg, size_t &num) {
+    const unsigned num_threads = get_text_format_threads(stream);
+    const size_t chunk_rows = std::max<size_t>(1, text_format_chunk_rows);
+    if(num_threads <= 1 || debug_flush_each_line) return false;
+    if(get_range_size(arg) < 2*chunk_rows) return false;
+
+    // All but one of the tasks of each batch are run on these.
+    std::optional<TextFormatThreads> workers;
+    if(!text_format_executor) workers.emplace(num_threads - 1);
+
+    num = 0;
+    while(!arg.is_end()) {
+        // Find where each chunk starts.  This is cheap compared to formatting.
+        std::vector<T> starts;
+        std::vector<size_t> counts;
+        for(unsigned t=0; t<num_threads && !arg.is_end(); t++) {
+            starts.push_back(arg);
+            size_t count = 0;
+            for(; count<chunk_rows && !arg.is_end(); count++) arg.inc();
+            counts.push_back(count);
+        }
+
+        std::vector<std::string> out(starts.size());
+        std::vector<std::exception_ptr> errors(starts.size());
+        std::vector<std::function<void()>> tasks;
+        for(size_t i=0; i<starts.size(); i++) {
+            tasks.push_back([&, i]() {
+                try {
+                    std::ostringstream buf;
+                    buf.copyfmt(stream);
+                    T r = starts[i];
+                    for(size_t k=0; k<counts[i]; k++, r.inc()) {
+                        deref_and_print(buf, r, PrintMode());
+                        buf << '\n';
+                    }
+                    out[i] = buf.str();
+                } catch(...) {
+                    errors[i] = std::current_exception();
+                }
+            });
+        }
+
+        if(text_format_executor) {
+            text_format_executor(tasks);
+        } else {
+            workers->run(tasks);
+        }
+
+        for(size_t i=0; i<starts.size(); i++) {
+            if(errors[i]) std::rethrow_exception(errors[i]);
+            stream.write(out[i].data(), static_cast<std::streamsize>(out[i].size()));
+            num += counts[i];
+        }
+    }
+    return true;
+}
+
+// Depth==1 and we are not asked to print the size of the array.  Send each element of the
+// range to deref_and_print() for further processing into columns.
+template <size_t Depth, typename T, typename PrintMode>
+typename std::enable_if_t<(Depth==1) && !PrintMode::is_size, std::array<size_t, 1>>
+print_block(std::ostream &stream, T &arg, PrintMode) {
+    if(PrintMode::is_binfmt && arg.is_end()) throw plotting_empty_container();
+    std::array<size_t, 1> shape = {0};
+    if constexpr (PrintMode::is_binary && is_contiguous_range<T>) {
+        if(send_contiguous_binary(stream, arg, shape[0])) return shape;
+    }
+    if constexpr (PrintMode::is_binary && has_strided_block<T>) {
+        if(send_strided_block<1>(stream, arg, shape)) return shape;
+    }
+    if constexpr (PrintMode::is_binary && InterleaveColumns<T>::is_tree) {
+        if(send_interleaved_binary(stream, arg, shape[0])) return shape;
+    }
+    if constexpr (PrintMode::is_text && has_range_size<T>) {
+        if(send_text_parallel<T, PrintMode>(stream, arg, shape[0])) return shape;
+    }
+    for(; !arg.is_end(); arg.inc()) {
+        //print_entry(arg.deref());
+        deref_and_print(stream, arg, PrintMode());
+        ++shape[0];
+        // If asked to print the binary format string, only the first element needs to be
+        // looked at.
+        if(PrintMode::is_binfmt) break;
+        if(PrintMode::is_text) {
+            stream << '\n';
+            if(debug_flush_each_line) stream << std::flush;
+        }
+    }
+    return shape;
+}
+
+// Tells whether a range can refill an existing subrange (see VecOfRange::deref_subiter_into).
+template <typename T, typename=void>
+static constexpr bool has_deref_subiter_into = false;
+
+template <typename T>
+static constexpr bool has_deref_subiter_into<T, std::void_t<
+        decltype(std::declval<const T &>().deref_subiter_into(
+            std::declval<typename T::subiter_type &>()))
+    >> = true;
+
+// Sets `sub` to `arg.deref_subiter()`, reusing the previous subrange if the range knows how.
+template <typename T>
+void assign_subiter(std::optional<typename T::subiter_type> &sub, const T &arg) {
+    if constexpr (has_deref_subiter_into<T>) {
+        if(sub) {
+            arg.deref_subiter_into(*sub);
+            return;
+        }
+    }
+    sub.emplace(arg.deref_subiter());
+}
+
+// Depth>1 and we are not asked to print the size of the array.  Loop over the range and
+// recurse into print_block() with Depth -> Depth-1.
+template <size_t Depth, typename T, typename PrintMode>
+typename std::enable_if_t<(Depth>1) && !PrintMode::is_size, std::array<size_t, Depth>>
+print_block(std::ostream &stream, T &arg, PrintMode) {
+    if(PrintMode::is_binfmt && arg.is_end()) throw plotting_empty_container();
+    std::array<size_t, Depth> shape = {0};
+    if constexpr (PrintMode::is_binary && has_strided_block<T>) {
+        if(send_strided_block<Depth>(stream, arg, shape)) return shape;
+    }
+    bool first = true;
+    std::optional<typename T::subiter_type> sub;
+    for(; !arg.is_end(); arg.inc()) {
+        if(first) {
+            first = false;
+        } else {
+            if(PrintMode::is_text) stream << '\n';
+        }
+        if(debug_array_print && PrintMode::is_text) stream << "<block>\n";
+        if(arg.is_end()) throw plotting_empty_container();
+        assign_subiter(sub, arg);
+        std::array<size_t, Depth-1> sub_shape = print_block<Depth-1>(stream, *sub, PrintMode());
+        if(!shape[Depth-1]) {
+            std::copy(sub_shape.begin(), sub_shape.end(), shape.begin());
+        }
+        ++shape[Depth-1];
+        // If asked to print the binary format string, only the first element needs to be
+        // looked at.
+        if(PrintMode::is_binfmt) break;
+    }
+    return shape;
+}
+
+// Depth==1 and we are asked to print the size of the array.
+template <size_t Depth, typename T, typename PrintMode>
+typename std::enable_if_t<(Depth==1) && PrintMode::is_size>
+print_block(std::ostream &stream, T &arg, PrintMode) {
+    stream << get_range_size(arg);
+}
+
+// Depth>1 and we are asked to print the size of the array.
+template <size_t Depth, typename T, typename PrintMode>
+typename std::enable_if_t<(Depth>1) && PrintMode::is_size>
+print_block(std::ostream &stream, T &arg, PrintMode) {
+    if(arg.is_end()) throw plotting_empty_container();
+    // It seems that size for two dimensional arrays needs the fastest varying index first,
+    // contrary to intuition.  The gnuplot documentation is not too clear on this point.
+    typename T::subiter_type sub = arg.deref_subiter();
+    print_block<Depth-1>(stream, sub, PrintMode());
+    stream << "," << get_range_size(arg);
+}
 
 // }}}2
 
@@ -1386,17 +2533,17 @@ print_block(std::ostream &stream, T &arg, PrintMode) {
 // print_block() for further processing.
 
 template <size_t Depth, typename T, typename PrintMode>
-void handle_colunwrap_tag(std::ostream &stream, const T &arg, ColUnwrapNo, PrintMode) {
+auto handle_colunwrap_tag(std::ostream &stream, const T &arg, ColUnwrapNo, PrintMode) {
     static_assert(ArrayTraits<T>::depth >= Depth, "container not deep enough");
     typename ArrayTraits<T>::range_type range = ArrayTraits<T>::get_range(arg);
-    print_block<Depth>(stream, range, PrintMode());
+    return print_block<Depth>(stream, range, PrintMode());
 }
 
 template <size_t Depth, typename T, typename PrintMode>
-void handle_colunwrap_tag(std::ostream &stream, const T &arg, ColUnwrapYes, PrintMode) {
+auto handle_colunwrap_tag(std::ostream &stream, const T &arg, ColUnwrapYes, PrintMode) {
     static_assert(ArrayTraits<T>::depth >= Depth+1, "container not deep enough");
     VecOfRange<typename ArrayTraits<T>::range_type::subiter_type> cols = get_columns_range(arg);
-    print_block<Depth>(stream, cols, PrintMode());
+    return print_block<Depth>(stream, cols, PrintMode());
 }
 
 // }}}2
@@ -1409,41 +2556,504 @@ void handle_colunwrap_tag(std::ostream &stream, const T &arg, ColUnwrapYes, Prin
 // support) then use ModeAutoDecoder to guess which of Mode1D, Mode2D, etc. should be used.
 
 template <typename T, typename PrintMode>
-void handle_organization_tag(std::ostream &stream, const T &arg, Mode1D, PrintMode) {
-    handle_colunwrap_tag<1>(stream, arg, ColUnwrapNo(), PrintMode());
+auto handle_organization_tag(std::ostream &stream, const T &arg, Mode1D, PrintMode) {
+    return handle_colunwrap_tag<1>(stream, arg, ColUnwrapNo(), PrintMode());
 }
 
 template <typename T, typename PrintMode>
-void handle_organization_tag(std::ostream &stream, const T &arg, Mode2D, PrintMode) {
-    handle_colunwrap_tag<2>(stream, arg, ColUnwrapNo(), PrintMode());
+auto handle_organization_tag(std::ostream &stream, const T &arg, Mode2D, PrintMode) {
+    return handle_colunwrap_tag<2>(stream, arg, ColUnwrapNo(), PrintMode());
 }
 
 template <typename T, typename PrintMode>
-void handle_organization_tag(std::ostream &stream, const T &arg, Mode1DUnwrap, PrintMode) {
-    handle_colunwrap_tag<1>(stream, arg, ColUnwrapYes(), PrintMode());
+auto handle_organization_tag(std::ostream &stream, const T &arg, Mode1DUnwrap, PrintMode) {
+    return handle_colunwrap_tag<1>(stream, arg, ColUnwrapYes(), PrintMode());
 }
 
 template <typename T, typename PrintMode>
-void handle_organization_tag(std::ostream &stream, const T &arg, Mode2DUnwrap, PrintMode) {
-    handle_colunwrap_tag<2>(stream, arg, ColUnwrapYes(), PrintMode());
+auto handle_organization_tag(std::ostream &stream, const T &arg, Mode2DUnwrap, PrintMode) {
+    return handle_colunwrap_tag<2>(stream, arg, ColUnwrapYes(), PrintMode());
 }
 
 template <typename T, typename PrintMode>
-void handle_organization_tag(std::ostream &stream, const T &arg, ModeAuto, PrintMode) {
-    handle_organization_tag(stream, arg, typename ModeAutoDecoder<T>::mode(), PrintMode());
+auto handle_organization_tag(std::ostream &stream, const T &arg, ModeAuto, PrintMode) {
+    return handle_organization_tag(stream, arg, typename ModeAutoDecoder<T>::mode(), PrintMode());
 }
 
 // }}}2
 
-// The entry point for the processing defined in this section.  It just forwards immediately to
-// handle_organization_tag().  This function is only here to give a sane name to the entry
-// point.
-//
-// The allowed values for the OrganizationMode and PrintMode tags are defined in the beginning
-// of this section.
-template <typename T, typename OrganizationMode, typename PrintMode>
-void top_level_array_sender(std::ostream &stream, const T &arg, OrganizationMode, PrintMode) {
-    handle_organization_tag(stream, arg, OrganizationMode(), PrintMode());
+// {{{2 Binary format string determined from the type
+//
+// The binary format string is usually determined by looking at the first element of the data
+// (via ModeBinfmt), since nested containers treated as columns may have any number of entries.
+// But when the columns are made of scalars, pairs, and tuples the format is fully determined by
+// the type of the range, and StaticBinfmt sends it without looking at the data at all.
+
+template <typename T>
+static constexpr bool is_pair_of_range = false;
+
+template <typename T, typename U>
+static constexpr bool is_pair_of_range<PairOfRange<T, U>> = true;
+
+template <typename T>
+static constexpr bool is_vec_of_range = false;
+
+template <typename T>
+static constexpr bool is_vec_of_range<VecOfRange<T>> = true;
+
+// The unspecialized version is for ranges where the data must be looked at.
+template <typename T, typename Enable=void>
+struct StaticBinfmt {
+    static constexpr bool available = false;
+};
+
+// Non-container ranges are sent by deref_and_print() via send_scalar().
+template <typename T>
+struct StaticBinfmt<T, typename std::enable_if_t<
+    !T::is_container && !is_pair_of_range<T> && !is_vec_of_range<T>
+>> {
+    static constexpr bool available = true;
+    static void send(std::ostream &stream) {
+        BinfmtSender<typename T::value_type>::send(stream);
+    }
+};
+
+// PairOfRange is sent by deref_and_print() as two sets of columns.
+template <typename T, typename U>
+struct StaticBinfmt<PairOfRange<T, U>> {
+    static constexpr bool available = StaticBinfmt<T>::available && StaticBinfmt<U>::available;
+    static void send(std::ostream &stream) {
+        StaticBinfmt<T>::send(stream);
+        StaticBinfmt<U>::send(stream);
+    }
+};
+
+// The type of range that gets passed to deref_and_print() (in other words, the range whose
+// elements are columns) for the given OrganizationMode.
+template <typename T, typename OrganizationMode>
+struct ColumnsRangeType { };
+
+template <typename T>
+struct ColumnsRangeType<T, Mode1D> {
+    typedef typename ArrayTraits<T>::range_type type;
+};
+
+template <typename T>
+struct ColumnsRangeType<T, Mode2D> {
+    typedef typename ArrayTraits<T>::range_type::subiter_type type;
+};
+
+template <typename T>
+struct ColumnsRangeType<T, Mode1DUnwrap> {
+    typedef VecOfRange<typename ArrayTraits<T>::range_type::subiter_type> type;
+};
+
+template <typename T>
+struct ColumnsRangeType<T, Mode2DUnwrap> {
+    typedef typename VecOfRange<typename ArrayTraits<T>::range_type::subiter_type>::subiter_type type;
+};
+
+template <typename T>
+struct ColumnsRangeType<T, ModeAuto> : ColumnsRangeType<T, typename ModeAutoDecoder<T>::mode> { };
+
+// }}}2
+
+// The entry point for the processing defined in this section.  It just forwards immediately to
+// handle_organization_tag().  This function is only here to give a sane name to the entry
+// point.  For the ModeText, ModeBinary, and ModeBinfmt tags, it returns the shape of the array
+// (see print_block()).
+//
+// The allowed values for the OrganizationMode and PrintMode tags are defined in the beginning
+// of this section.
+template <typename T, typename OrganizationMode, typename PrintMode>
+auto top_level_array_sender(std::ostream &stream, const T &arg, OrganizationMode, PrintMode) {
+    return handle_organization_tag(stream, arg, OrganizationMode(), PrintMode());
+}
+
+// Returns the binary format string (e.g. "%double%double").  This only looks at the data if the
+// format can't be determined from the type (see StaticBinfmt).  Throws plotting_empty_container
+// if the data needed to be looked at and was empty.
+template <typename T, typename OrganizationMode>
+std::string top_level_binfmt(const T &arg, OrganizationMode) {
+    typedef typename ColumnsRangeType<T, OrganizationMode>::type columns_range_type;
+    std::ostringstream tmp;
+    if constexpr (StaticBinfmt<columns_range_type>::available) {
+        StaticBinfmt<columns_range_type>::send(tmp);
+    } else {
+        top_level_array_sender(tmp, arg, OrganizationMode(), ModeBinfmt());
+    }
+    return tmp.str();
+}
+
+// }}}1
+
+// {{{1 Single precision wrapper (as_float)
+//
+// `as_float(arg)` can be passed anywhere a container can, and sends the data with any double
+// precision entries converted to float (see DowncastValue).  In binary mode this halves the
+// amount of data, and the format string automatically says `%float`.  The wrapper only holds a
+// pointer to `arg`, unless `arg` is a temporary.
+
+template <typename R>
+class FloatRange;
+
+// Gives the range that is used in place of R.  PairOfRange and VecOfRange (which are treated as
+// columns by deref_and_print) are looked into, so that the conversion happens on their
+// children.
+template <typename R>
+struct FloatRangeMap {
+    typedef FloatRange<R> type;
+    static type wrap(const R &r) { return type(r); }
+};
+
+template <>
+struct FloatRangeMap<Error_WasNotContainer> {
+    typedef Error_WasNotContainer type;
+};
+
+template <typename RT, typename RU>
+struct FloatRangeMap<PairOfRange<RT, RU>> {
+    typedef PairOfRange<typename FloatRangeMap<RT>::type, typename FloatRangeMap<RU>::type> type;
+    static type wrap(const PairOfRange<RT, RU> &r) {
+        return type(FloatRangeMap<RT>::wrap(r.l), FloatRangeMap<RU>::wrap(r.r));
+    }
+};
+
+template <typename RT>
+struct FloatRangeMap<VecOfRange<RT>> {
+    typedef VecOfRange<typename FloatRangeMap<RT>::type> type;
+    static type wrap(const VecOfRange<RT> &r) {
+        std::vector<typename FloatRangeMap<RT>::type> rvec;
+        rvec.reserve(r.rvec.size());
+        for(const RT &x : r.rvec) rvec.push_back(FloatRangeMap<RT>::wrap(x));
+        return type(rvec);
+    }
+};
+
+template <typename R>
+class FloatRange {
+public:
+    FloatRange() { }
+    explicit FloatRange(const R &_r) : r(_r) { }
+
+    typedef typename DowncastValue<typename R::value_type>::type value_type;
+    typedef typename FloatRangeMap<typename R::subiter_type>::type subiter_type;
+    static constexpr bool is_container = R::is_container;
+
+    bool is_end() const { return r.is_end(); }
+
+    void inc() { r.inc(); }
+
+    template <typename R2=R>
+    typename std::enable_if_t<has_range_size<R2>, size_t>
+    size() const { return r.size(); }
+
+    value_type deref() const {
+        return DowncastValue<typename R::value_type>::apply(r.deref());
+    }
+
+    subiter_type deref_subiter() const {
+        return FloatRangeMap<typename R::subiter_type>::wrap(r.deref_subiter());
+    }
+
+    // Allows the bulk binary path to convert whole blocks at a time.
+    template <typename R2=R>
+    typename std::enable_if_t<has_strided_block<R2> || is_contiguous_range<R2>,
+        StridedBlock<typename R::value_type, value_type>>
+    strided_block() const {
+        if constexpr (has_strided_block<R2>) {
+            const auto b = r.strided_block();
+            static_assert(std::is_same_v<typename decltype(b)::value_type, typename decltype(b)::out_type>);
+            return StridedBlock<typename R::value_type, value_type>{ b.base, b.n, b.stride };
+        } else {
+            const typename R::value_type *p = r.is_end() ? nullptr : r.contiguous_data();
+            return StridedBlock<typename R::value_type, value_type>{ p,
+                {{ p ? get_range_size(r) : 0, 1, 1 }},
+                {{ 1, 1, 1 }} };
+        }
+    }
+
+private:
+    R r;
+};
+
+template <typename T>
+struct FloatCastWrapper {
+    const T *p;
+    // Set if the wrapper was made from a temporary, which is then kept here.
+    std::shared_ptr<const T> owned;
+};
+
+template <typename T>
+FloatCastWrapper<T> as_float(const T &arg) {
+    return FloatCastWrapper<T>{&arg, nullptr};
+}
+
+// A temporary (e.g. `as_float(std::make_pair(xs, ys))`) is moved into the wrapper, so that it
+// stays valid when the wrapper is kept by PlotGroup::by_reference().
+template <typename T, typename=std::enable_if_t<!std::is_lvalue_reference_v<T>>>
+FloatCastWrapper<T> as_float(T &&arg) {
+    auto owned = std::make_shared<const T>(std::move(arg));
+    return FloatCastWrapper<T>{owned.get(), owned};
+}
+
+template <typename T>
+static constexpr bool is_view_type<FloatCastWrapper<T>> = true;
+
+template <typename T>
+class ArrayTraitsImpl<FloatCastWrapper<T>> {
+public:
+    typedef typename FloatRangeMap<typename ArrayTraits<T>::range_type>::type range_type;
+    typedef typename DowncastValue<typename ArrayTraits<T>::value_type>::type value_type;
+    static constexpr bool is_container = ArrayTraits<T>::is_container;
+    static constexpr bool allow_auto_unwrap = ArrayTraits<T>::allow_auto_unwrap;
+    static constexpr size_t depth = ArrayTraits<T>::depth;
+
+    static range_type get_range(const FloatCastWrapper<T> &arg) {
+        return FloatRangeMap<typename ArrayTraits<T>::range_type>::wrap(ArrayTraits<T>::get_range(*arg.p));
+    }
+};
+
+// }}}1
+
+// {{{1 Images and matrices
+
+// A 2D image stored in memory: `height` rows of `width` pixels, each pixel being `Channels`
+// consecutive values (1 for a grayscale image or a matrix, 3 for RGB, 4 for RGBA).  Pixel
+// (row, col) starts at `data[row*row_stride + col*col_stride]`, so row major, column major (e.g.
+// Armadillo or Eigen storage, with the strides swapped), and sub-images can all be described
+// without copying.  The data must outlive the view.
+//
+// Views can be passed to any of the send, binFmt, and PlotGroup functions as 2D data, with
+// pixels being sent a row at a time (x varying fastest).  The image functions of Gnuplot
+// (imageFmt, sendImage, binMatrixFile) also take any other 2D container.
+template <typename T, size_t Channels=1>
+struct ImageView {
+    const T *data;
+    size_t width;
+    size_t height;
+    ptrdiff_t row_stride;
+    ptrdiff_t col_stride;
+};
+
+// Row major data, with rows `row_stride` values apart (0 means packed).
+template <typename T>
+ImageView<T, 1> image_view(const T *data, size_t width, size_t height, ptrdiff_t row_stride=0) {
+    return ImageView<T, 1>{data, width, height,
+        row_stride ? row_stride : static_cast<ptrdiff_t>(width), 1};
+}
+
+// Packed 8 bit RGB or RGBA data (e.g. a camera frame), for `with rgbimage` or `with rgbalpha`.
+// `row_stride` is in bytes (0 means packed).
+inline ImageView<uint8_t, 3> rgb_view(const uint8_t *data, size_t width, size_t height, ptrdiff_t row_stride=0) {
+    return ImageView<uint8_t, 3>{data, width, height,
+        row_stride ? row_stride : static_cast<ptrdiff_t>(3*width), 3};
+}
+
+inline ImageView<uint8_t, 4> rgba_view(const uint8_t *data, size_t width, size_t height, ptrdiff_t row_stride=0) {
+    return ImageView<uint8_t, 4>{data, width, height,
+        row_stride ? row_stride : static_cast<ptrdiff_t>(4*width), 4};
+}
+
+template <typename T, size_t Channels>
+static constexpr bool is_view_type<ImageView<T, Channels>> = true;
+
+// Range over an ImageView.  Levels is 2 (rows, pixels) for single channel images and 3 (rows,
+// pixels, channels) otherwise.  Each level has a count and a stride, and the whole remaining
+// range is available as a strided_block(), which is how binary data gets sent.
+template <typename T, size_t Levels>
+class ImageRange {
+public:
+    ImageRange() : p(nullptr), i(0), n(), stride() { }
+    ImageRange(const T *_p, const size_t *_n, const ptrdiff_t *_stride) : p(_p), i(0) {
+        std::copy(_n, _n+Levels, n.begin());
+        std::copy(_stride, _stride+Levels, stride.begin());
+    }
+
+    static constexpr bool is_container = Levels > 1;
+
+    struct Error_InappropriateDeref { };
+    using value_type = typename std::conditional_t<is_container, Error_InappropriateDeref, T>;
+    using subiter_type = typename std::conditional_t<is_container,
+        ImageRange<T, (Levels > 1 ? Levels-1 : 1)>, Error_WasNotContainer>;
+
+    bool is_end() const { return i == n[0]; }
+
+    void inc() { ++i; }
+
+    size_t size() const { return n[0] - i; }
+
+    value_type deref() const {
+        return p[static_cast<ptrdiff_t>(i) * stride[0]];
+    }
+
+    subiter_type deref_subiter() const {
+        return subiter_type(p + static_cast<ptrdiff_t>(i) * stride[0], n.data()+1, stride.data()+1);
+    }
+
+    StridedBlock<T> strided_block() const {
+        StridedBlock<T> b{ is_end() ? nullptr : p + static_cast<ptrdiff_t>(i) * stride[0],
+            {{ 1, 1, 1 }}, {{ 1, 1, 1 }} };
+        b.n[0] = n[0] - i;
+        for(size_t d=0; d<Levels; d++) {
+            if(d) b.n[d] = n[d];
+            b.stride[d] = stride[d];
+        }
+        return b;
+    }
+
+private:
+    const T *p;
+    size_t i;
+    std::array<size_t, Levels> n;
+    std::array<ptrdiff_t, Levels> stride;
+};
+
+template <typename T, size_t Channels>
+class ArrayTraitsImpl<ImageView<T, Channels>> {
+public:
+    static constexpr size_t depth = Channels > 1 ? 3 : 2;
+    typedef ImageRange<T, depth> range_type;
+    typedef T value_type;
+    static constexpr bool is_container = true;
+    static constexpr bool allow_auto_unwrap = false;
+
+    static range_type get_range(const ImageView<T, Channels> &arg) {
+        const size_t n[3] = { arg.height, arg.width, Channels };
+        const ptrdiff_t stride[3] = { arg.row_stride, arg.col_stride, 1 };
+        return range_type(arg.data, n, stride);
+    }
+};
+
+// Placement of an image in plot coordinates, for Gnuplot::imageFmt and binMatrixFile: the
+// center of the first pixel is at (x0, y0), and pixels are dx by dy apart.
+struct ImageGeometry {
+    double x0 = 0;
+    double y0 = 0;
+    double dx = 1;
+    double dy = 1;
+};
+
+// Geometry putting the centers of the corner pixels of a width by height image at the given
+// coordinates.
+inline ImageGeometry image_extent(double xmin, double xmax, double ymin, double ymax, size_t width, size_t height) {
+    ImageGeometry g;
+    g.x0 = xmin;
+    g.y0 = ymin;
+    g.dx = width  > 1 ? (xmax - xmin) / static_cast<double>(width  - 1) : 1;
+    g.dy = height > 1 ? (ymax - ymin) / static_cast<double>(height - 1) : 1;
+    return g;
+}
+
+// }}}1
+
+// {{{1 Decimation
+//
+// Reduces a long 1D series to roughly `target_points` points by keeping the minimum and maximum
+// of each bucket of consecutive points (in their original order).  Unlike plain subsampling, this
+// preserves the peaks that would be visible if all points were plotted.
+
+// The value that min/max is taken over: the entry itself for scalars, the second column for
+// pairs and tuples (the first column being x).
+template <typename T, typename=void>
+struct DecimateKey {
+    static double get(const T &v) { return static_cast<double>(v); }
+};
+
+template <typename T, typename U>
+struct DecimateKey<std::pair<T, U>> {
+    static double get(const std::pair<T, U> &v) { return static_cast<double>(v.second); }
+};
+
+template <typename... Args>
+struct DecimateKey<std::tuple<Args...>> {
+    static_assert(sizeof...(Args) >= 2, "decimation needs at least two columns");
+    static double get(const std::tuple<Args...> &v) { return static_cast<double>(std::get<1>(v)); }
+};
+
+template <typename T>
+struct DecimateKey<T, std::enable_if_t<is_boost_tuple<T>>> {
+    static double get(const T &v) { return static_cast<double>(boost::get<1>(v)); }
+};
+
+// Scalar series get the sample index as the x column, so that the result can still be plotted
+// against the original positions.  The index is a uint64_t rather than a size_t, since binary
+// sends only know the fixed width integer types (and size_t isn't one of them everywhere).
+template <typename V>
+using decimated_entry_t = std::conditional_t<std::is_arithmetic_v<V>, std::pair<uint64_t, V>, V>;
+
+// Throws std::invalid_argument if `target_points` is less than two.
+template <typename T>
+std::vector<decimated_entry_t<typename ArrayTraits<T>::range_type::value_type>>
+decimate_minmax(const T &arg, size_t target_points) {
+    typedef typename ArrayTraits<T>::range_type range_type;
+    static_assert(ArrayTraits<T>::depth == 1 && !range_type::is_container,
+        "decimation only works on one dimensional data");
+    typedef typename range_type::value_type V;
+    typedef decimated_entry_t<V> E;
+
+    auto entry = [](size_t i, const V &v) -> E {
+        if constexpr (std::is_arithmetic_v<V>) {
+            return E(static_cast<uint64_t>(i), v);
+        } else {
+            (void)i;
+            return v;
+        }
+    };
+
+    // With fewer than two points there would be no buckets at all, and the whole series would be
+    // returned.
+    if(target_points < 2) {
+        throw std::invalid_argument("decimate_minmax needs target_points >= 2");
+    }
+
+    range_type range = ArrayTraits<T>::get_range(arg);
+    const size_t n = get_range_size(range);
+    std::vector<E> ret;
+
+    // Each bucket contributes two points.
+    const size_t num_buckets = target_points / 2;
+    if(n <= target_points) {
+        ret.reserve(n);
+        for(size_t i=0; !range.is_end(); range.inc(), i++) {
+            ret.push_back(entry(i, range.deref()));
+        }
+        return ret;
+    }
+
+    const size_t bucket_size = (n + num_buckets - 1) / num_buckets;
+    ret.reserve(2 * num_buckets);
+    for(size_t i=0; !range.is_end(); ) {
+        // NaN keys compare false with everything, so they are skipped.  A bucket of nothing but
+        // NaN becomes a single NaN point, so that the gap still shows.
+        std::optional<V> lo, hi, gap;
+        size_t lo_i = 0, hi_i = 0, gap_i = 0;
+        double lo_key = 0, hi_key = 0;
+        for(size_t j=0; j<bucket_size && !range.is_end(); j++, range.inc(), i++) {
+            V v = range.deref();
+            double key = DecimateKey<V>::get(v);
+            if(std::isnan(key)) {
+                if(!gap) { gap = v; gap_i = i; }
+                continue;
+            }
+            if(!lo || key < lo_key) { lo = v; lo_key = key; lo_i = i; }
+            if(!hi || key > hi_key) { hi = v; hi_key = key; hi_i = i; }
+        }
+        if(!lo) {
+            ret.push_back(entry(gap_i, *gap));
+            continue;
+        }
+        if(lo_i == hi_i) {
+            ret.push_back(entry(lo_i, *lo));
+        } else if(lo_i < hi_i) {
+            ret.push_back(entry(lo_i, *lo));
+            ret.push_back(entry(hi_i, *hi));
+        } else {
+            ret.push_back(entry(hi_i, *hi));
+            ret.push_back(entry(lo_i, *lo));
+        }
+    }
+    return ret;
 }
 
 // }}}1
@@ -1454,12 +3064,17 @@ class PlotData {
 public:
     PlotData() { }
 
-    template <typename T, typename OrganizationMode, typename PrintMode>
+    // If `by_reference` is set, only a pointer to `arg` is kept and the data is serialized
+    // straight into the destination stream when it is sent (see write_data()).  In that case
+    // `arg` must outlive this object and must not be modified in the meantime.  Temporaries (such
+    // as `std::make_pair(xs, ys)`) are moved into this object instead.
+    template <typename TRef, typename OrganizationMode, typename PrintMode>
     PlotData(
-        const T &arg,
+        TRef &&arg,
         const std::string &_plotspec,
         const std::string &_arr_or_rec,
-        OrganizationMode, PrintMode
+        OrganizationMode, PrintMode,
+        bool by_reference=false
     ) :
         plotspec(_plotspec),
         is_text(PrintMode::is_text),
@@ -1467,23 +3082,63 @@ public:
         has_data(true),
         arr_or_rec(_arr_or_rec)
     {
-        {
-            std::ostringstream tmp;
-            top_level_array_sender(tmp, arg, OrganizationMode(), PrintMode());
-            data = tmp.str();
+        typedef std::remove_cv_t<std::remove_reference_t<TRef>> T;
+
+        if(by_reference) {
+            // View types (e.g. from as_float) are usually temporaries, so they are copied.
+            const T *p = &arg;
+            std::shared_ptr<const void> copy;
+            if constexpr (is_view_type<T> || !std::is_lvalue_reference_v<TRef>) {
+                auto c = std::make_shared<const T>(std::forward<TRef>(arg));
+                p = c.get();
+                copy = c;
+            }
+            writer = [p, copy](std::ostream &os) {
+                // Use the same formatting that a fresh std::ostringstream would have, so the
+                // output doesn't depend on whether the data was buffered.
+                std::ios_base::fmtflags flags = os.flags(std::ios_base::dec | std::ios_base::skipws);
+                std::streamsize precision = os.precision(6);
+                std::streamsize width = os.width(0);
+                top_level_array_sender(os, *p, OrganizationMode(), PrintMode());
+                os.flags(flags);
+                os.precision(precision);
+                os.width(width);
+            };
+            if(!is_text) {
+                // Only the size pass is needed here, and that is cheap for ranges that
+                // implement size().
+                try {
+                    std::ostringstream tmp;
+                    top_level_array_sender(tmp, *p, OrganizationMode(), ModeSize());
+                    bin_size = tmp.str();
+                    if(("," + bin_size + ",").find(",0,") != std::string::npos) {
+                        throw plotting_empty_container();
+                    }
+                    bin_fmt = top_level_binfmt(*p, OrganizationMode());
+                } catch(const plotting_empty_container &) {
+                    bin_fmt = "";
+                    bin_size = "0";
+                }
+            }
+            return;
         }
 
+        // The data is only traversed once.  The array size comes from this same pass, and the
+        // format string is normally determined from the type alone (see top_level_binfmt).
+        std::ostringstream tmp;
+        const auto shape = top_level_array_sender(tmp, arg, OrganizationMode(), PrintMode());
+        data = std::make_shared<const std::string>(tmp.str());
+
         if(!is_text) {
             try {
-                {
-                    std::ostringstream tmp;
-                    top_level_array_sender(tmp, arg, OrganizationMode(), ModeBinfmt());
-                    bin_fmt = tmp.str();
+                if(std::find(shape.begin(), shape.end(), 0) != shape.end()) {
+                    throw plotting_empty_container();
                 }
-                {
-                    std::ostringstream tmp;
-                    top_level_array_sender(tmp, arg, OrganizationMode(), ModeSize());
-                    bin_size = tmp.str();
+                bin_fmt = top_level_binfmt(arg, OrganizationMode());
+                bin_size.clear();
+                for(size_t i=0; i<shape.size(); i++) {
+                    if(i) bin_size += ",";
+                    bin_size += std::to_string(shape[i]);
                 }
             } catch(const plotting_empty_container &) {
                 bin_fmt = "";
@@ -1499,14 +3154,21 @@ public:
         has_data(false)
     { }
 
-    PlotData &file(const std::string &fn) {
+    // With `staged`, the data is written to a staging file which then replaces `fn` (see
+    // replace_file()), so that gnuplot never sees a partly written file.
+    PlotData &file(const std::string &fn, bool staged=false) {
         filename = fn;
         is_inline = false;
 
+        if(staged) {
+            replace_file(filename, !is_text, [this](std::ostream &os) { write_data(os); });
+            return *this;
+        }
+
         std::ios_base::openmode mode = std::fstream::out;
         if(!is_text) mode |= std::fstream::binary;
         std::fstream fh(filename.c_str(), mode);
-        fh << data;
+        write_data(fh);
         fh.close();
 
         return *this;
@@ -1533,8 +3195,22 @@ public:
         return is_inline;
     }
 
+    // Writes the data block (not including the "e" terminator for text data).
+    void write_data(std::ostream &os) const {
+        if(writer) {
+            writer(os);
+        } else if(data) {
+            os.write(data->data(), static_cast<std::streamsize>(data->size()));
+        }
+    }
+
     const std::string &getData() const {
-        return data;
+        if(!data) {
+            std::ostringstream tmp;
+            write_data(tmp);
+            data = std::make_shared<const std::string>(tmp.str());
+        }
+        return *data;
     }
 
     bool isText() const { return is_text; }
@@ -1551,7 +3227,10 @@ private:
     bool is_text;
     bool is_inline;
     bool has_data;
-    std::string data;
+    // Shared so that copying a PlotData (or a PlotGroup) doesn't copy the data.
+    mutable std::shared_ptr<const std::string> data;
+    // Set if the data is serialized at send time rather than buffered in `data`.
+    std::function<void(std::ostream &)> writer;
     std::string filename;
     std::string arr_or_rec;
     std::string bin_fmt;
@@ -1562,7 +3241,16 @@ class PlotGroup {
 public:
     friend class Gnuplot;
 
-    explicit PlotGroup(const std::string &plot_type_) : plot_type(plot_type_) { }
+    explicit PlotGroup(const std::string &plot_type_) : plot_type(plot_type_), by_ref(false) { }
+
+    // If enabled, plots added after this call keep a reference to the container rather than a
+    // serialized copy, and the data is written directly to gnuplot when the group is sent.  The
+    // containers must then outlive the send and must not change before it happens.  Temporaries
+    // passed to add_plot*() are moved into the group rather than referred to.
+    PlotGroup &by_reference(bool state=true) {
+        by_ref = state;
+        return *this;
+    }
 
     PlotGroup &add_preamble(const std::string &s) {
         preamble_lines.push_back(s);
@@ -1571,10 +3259,17 @@ public:
 
     PlotGroup &add_plot(const std::string &plotspec) { plots.emplace_back(plotspec); return *this; }
 
-    template <typename T> PlotGroup &add_plot1d         (const T &arg, const std::string &plotspec="", const std::string &text_array_record="text") { add(arg, plotspec, text_array_record, Mode1D      ()); return *this; }
-    template <typename T> PlotGroup &add_plot2d         (const T &arg, const std::string &plotspec="", const std::string &text_array_record="text") { add(arg, plotspec, text_array_record, Mode2D      ()); return *this; }
-    template <typename T> PlotGroup &add_plot1d_colmajor(const T &arg, const std::string &plotspec="", const std::string &text_array_record="text") { add(arg, plotspec, text_array_record, Mode1DUnwrap()); return *this; }
-    template <typename T> PlotGroup &add_plot2d_colmajor(const T &arg, const std::string &plotspec="", const std::string &text_array_record="text") { add(arg, plotspec, text_array_record, Mode2DUnwrap()); return *this; }
+    template <typename T> PlotGroup &add_plot1d         (T &&arg, const std::string &plotspec="", const std::string &text_array_record="text") { add(std::forward<T>(arg), plotspec, text_array_record, Mode1D      ()); return *this; }
+    template <typename T> PlotGroup &add_plot2d         (T &&arg, const std::string &plotspec="", const std::string &text_array_record="text") { add(std::forward<T>(arg), plotspec, text_array_record, Mode2D      ()); return *this; }
+    template <typename T> PlotGroup &add_plot1d_colmajor(T &&arg, const std::string &plotspec="", const std::string &text_array_record="text") { add(std::forward<T>(arg), plotspec, text_array_record, Mode1DUnwrap()); return *this; }
+    template <typename T> PlotGroup &add_plot2d_colmajor(T &&arg, const std::string &plotspec="", const std::string &text_array_record="text") { add(std::forward<T>(arg), plotspec, text_array_record, Mode2DUnwrap()); return *this; }
+
+    // See decimate_minmax().  The decimated data is always buffered, even in by_reference()
+    // mode, since it is a temporary.
+    template <typename T> PlotGroup &add_plot1d_decimated(const T &arg, size_t target_points, const std::string &plotspec="", const std::string &text_array_record="text") {
+        add(decimate_minmax(arg, target_points), plotspec, text_array_record, Mode1D(), false);
+        return *this;
+    }
 
     PlotGroup &file(const std::string &fn) {
         assert(!plots.empty());
@@ -1586,7 +3281,12 @@ public:
 
 private:
     template <typename T, typename OrganizationMode>
-    void add(const T &arg, const std::string &plotspec, const std::string &text_array_record, OrganizationMode) {
+    void add(T &&arg, const std::string &plotspec, const std::string &text_array_record, OrganizationMode) {
+        add(std::forward<T>(arg), plotspec, text_array_record, OrganizationMode(), by_ref);
+    }
+
+    template <typename T, typename OrganizationMode>
+    void add(T &&arg, const std::string &plotspec, const std::string &text_array_record, OrganizationMode, bool by_reference) {
         if(!(
             text_array_record == "text" ||
             text_array_record == "array" ||
@@ -1595,18 +3295,19 @@ private:
             text_array_record+")");
 
         if(text_array_record == "text") {
-            plots.emplace_back(arg, plotspec,
+            plots.emplace_back(std::forward<T>(arg), plotspec,
                 "array", // arbitrary value
-                OrganizationMode(), ModeText());
+                OrganizationMode(), ModeText(), by_reference);
         } else {
-            plots.emplace_back(arg, plotspec, text_array_record,
-                OrganizationMode(), ModeBinary());
+            plots.emplace_back(std::forward<T>(arg), plotspec, text_array_record,
+                OrganizationMode(), ModeBinary(), by_reference);
         }
     }
 
     std::string plot_type;
     std::vector<std::string> preamble_lines;
     std::vector<PlotData> plots;
+    bool by_ref;
 };
 
 // }}}1
@@ -1648,8 +3349,323 @@ struct FileHandleWrapper {
 
 // }}}1
 
+// {{{1 Asynchronous writer
+
+// What to do when a frame is sent while the queue of the asynchronous writer is full.
+enum class AsyncPolicy {
+    // Wait for the writer thread to make room.  Nothing is lost.
+    Block,
+    // Discard the oldest frame that hasn't been written yet.
+    DropOldest,
+    // Discard all frames that haven't been written yet, whether or not the queue is full, so
+    // that gnuplot always gets the newest frame next.
+    Coalesce
+};
+
+// Writes buffers to a file descriptor from a background thread.  Each buffer ("frame") is
+// written in one piece, so dropping a frame never leaves gnuplot with a partial command.
+class GnuplotAsyncWriter {
+public:
+    GnuplotAsyncWriter(int fd, size_t _max_queue, AsyncPolicy _policy) :
+        max_queue(_max_queue ? _max_queue : 1),
+        policy(_policy),
+        busy(false),
+        stopping(false),
+        num_dropped(0),
+        thread([this, fd]() { run(fd); })
+    { }
+
+private:
+    // noncopyable
+    GnuplotAsyncWriter(const GnuplotAsyncWriter &) = delete;
+    const GnuplotAsyncWriter& operator=(const GnuplotAsyncWriter &) = delete;
+
+public:
+    // Writes everything that is queued, then stops the thread.
+    ~GnuplotAsyncWriter() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        cond.notify_all();
+        thread.join();
+    }
+
+    // A frame that is not `droppable` is always written, whatever the policy (this is used for
+    // things like datablocks, which later frames depend on).
+    void push(std::string &&frame, bool droppable=true) {
+        if(frame.empty()) return;
+        std::unique_lock<std::mutex> lock(mutex);
+        if(policy == AsyncPolicy::Coalesce) {
+            const size_t n = queue.size();
+            queue.erase(std::remove_if(queue.begin(), queue.end(),
+                [](const Frame &f) { return f.droppable; }), queue.end());
+            num_dropped += n - queue.size();
+        } else if(policy == AsyncPolicy::DropOldest) {
+            while(queue.size() >= max_queue) {
+                auto it = std::find_if(queue.begin(), queue.end(),
+                    [](const Frame &f) { return f.droppable; });
+                if(it == queue.end()) break;
+                queue.erase(it);
+                ++num_dropped;
+            }
+        }
+        cond.wait(lock, [this]() { return queue.size() < max_queue || !error.empty(); });
+        queue.push_back(Frame{std::move(frame), droppable});
+        cond.notify_all();
+    }
+
+    // Blocks until everything that was queued has been written.
+    void wait_idle() {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [this]() { return (queue.empty() && !busy) || !error.empty(); });
+        if(!error.empty()) {
+            throw std::ios_base::failure(error);
+        }
+    }
+
+    size_t dropped() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return num_dropped;
+    }
+
+    AsyncPolicy get_policy() const {
+        return policy;
+    }
+
+private:
+    void run(int fd) {
+        boost::iostreams::stream<boost::iostreams::file_descriptor_sink> out(
+            fd,
+#if BOOST_VERSION >= 104400
+            boost::iostreams::never_close_handle
+#else
+            false
+#endif
+        );
+        std::unique_lock<std::mutex> lock(mutex);
+        for(;;) {
+            cond.wait(lock, [this]() { return !queue.empty() || stopping; });
+            if(queue.empty()) break;
+            std::string frame = std::move(queue.front().data);
+            queue.pop_front();
+            busy = true;
+            // Let a blocked producer continue while this frame is written.
+            cond.notify_all();
+            lock.unlock();
+            if(error.empty()) {
+                out.write(frame.data(), static_cast<std::streamsize>(frame.size()));
+                out.flush();
+            }
+            lock.lock();
+            busy = false;
+            if(!out && error.empty()) {
+                error = "write to gnuplot failed";
+            }
+            cond.notify_all();
+        }
+    }
+
+    struct Frame {
+        std::string data;
+        bool droppable;
+    };
+
+    const size_t max_queue;
+    const AsyncPolicy policy;
+    mutable std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<Frame> queue;
+    bool busy;
+    bool stopping;
+    size_t num_dropped;
+    std::string error;
+    // Must come last, so that everything above is initialized before the thread starts.
+    std::thread thread;
+};
+
+// Stream buffer that collects output into frames and hands each completed frame to a
+// GnuplotAsyncWriter.  end_frame() ends a frame, which Gnuplot::do_flush() calls (see
+// Gnuplot::useAsyncWriter for when).  Flushing the stream (e.g. std::endl) also ends the frame
+// under AsyncPolicy::Block, where nothing is dropped, but not under the dropping policies.
+class GnuplotAsyncBuf : public std::streambuf {
+public:
+    explicit GnuplotAsyncBuf(GnuplotAsyncWriter &_writer) :
+        writer(_writer), buf(1 << 16)
+    {
+        setp(buf.data(), buf.data() + buf.size());
+    }
+
+    void end_frame(bool droppable=true) {
+        collect();
+        writer.push(std::move(pending), droppable);
+        pending.clear();
+    }
+
+protected:
+    int_type overflow(int_type c) override {
+        collect();
+        if(!traits_type::eq_int_type(c, traits_type::eof())) {
+            pending += traits_type::to_char_type(c);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(const char *s, std::streamsize n) override {
+        if(n > epptr() - pptr()) {
+            collect();
+            pending.append(s, static_cast<size_t>(n));
+            return n;
+        }
+        return std::streambuf::xsputn(s, n);
+    }
+
+    int sync() override {
+        if(writer.get_policy() == AsyncPolicy::Block) {
+            end_frame();
+        } else {
+            collect();
+        }
+        return 0;
+    }
+
+private:
+    // Moves the buffered output to the current frame.
+    void collect() {
+        pending.append(pbase(), static_cast<size_t>(pptr() - pbase()));
+        setp(buf.data(), buf.data() + buf.size());
+    }
+
+    GnuplotAsyncWriter &writer;
+    std::vector<char> buf;
+    std::string pending;
+};
+
+// }}}1
+
+// {{{1 Statistics
+
+// Numbers for a single send.
+struct GnuplotSendStats {
+    // Whether any binary data was sent.
+    bool binary = false;
+    size_t bytes = 0;
+    // Time spent formatting the data, and time spent blocked writing it to gnuplot.
+    double serialize_seconds = 0;
+    double write_seconds = 0;
+};
+
+// Counters kept by Gnuplot once stats are enabled (see Gnuplot::enableStats).
+struct GnuplotStats {
+    // Everything written to gnuplot, including commands.
+    size_t bytes = 0;
+    // Written by send(), sendBinary(), datablock(), and send(PlotGroup).  Binary data counts
+    // as binary, everything else (including the plot command of a PlotGroup) as text.
+    size_t text_bytes = 0;
+    size_t binary_bytes = 0;
+    size_t sends = 0;
+    // Number of times the stream was flushed.
+    size_t flushes = 0;
+    // Time spent formatting data during sends, and time spent blocked writing to gnuplot (for
+    // all writes, not just sends).
+    double serialize_seconds = 0;
+    double write_seconds = 0;
+    size_t tmpfiles_created = 0;
+    // Round trips of getMouse() and query().  For getMouse() this includes the time waiting
+    // for the user to click.
+    size_t feedback_round_trips = 0;
+    double feedback_seconds = 0;
+    GnuplotSendStats last_send;
+};
+
+// Sits in front of the real stream buffer, counting bytes and flushes and timing the writes.
+class GnuplotMeterBuf : public std::streambuf {
+public:
+    explicit GnuplotMeterBuf(std::streambuf *_dest) :
+        dest(_dest), buf(1 << 16), total(0), num_flushes(0), write_time(0)
+    {
+        setp(buf.data(), buf.data() + buf.size());
+    }
+
+    std::streambuf *get_dest() const { return dest; }
+
+    // Returns the previous destination.  Buffered output goes to that one first.
+    std::streambuf *set_dest(std::streambuf *_dest) {
+        drain();
+        std::streambuf *old = dest;
+        dest = _dest;
+        return old;
+    }
+
+    size_t bytes() const { return total + static_cast<size_t>(pptr() - pbase()); }
+    size_t flushes() const { return num_flushes; }
+    double write_seconds() const { return write_time.count(); }
+
+    void reset_counters() {
+        drain();
+        total = 0;
+        num_flushes = 0;
+        write_time = std::chrono::duration<double>(0);
+    }
+
+protected:
+    int_type overflow(int_type c) override {
+        if(drain()) return traits_type::eof();
+        if(!traits_type::eq_int_type(c, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(const char *s, std::streamsize n) override {
+        if(n > epptr() - pptr()) {
+            // Large blocks (e.g. from the strided binary kernel) skip the copy.
+            if(drain()) return 0;
+            const auto start = std::chrono::steady_clock::now();
+            const std::streamsize ret = dest->sputn(s, n);
+            write_time += std::chrono::steady_clock::now() - start;
+            total += static_cast<size_t>(ret);
+            return ret;
+        }
+        return std::streambuf::xsputn(s, n);
+    }
+
+    int sync() override {
+        ++num_flushes;
+        if(drain()) return -1;
+        const auto start = std::chrono::steady_clock::now();
+        const int ret = dest->pubsync();
+        write_time += std::chrono::steady_clock::now() - start;
+        return ret;
+    }
+
+private:
+    int drain() {
+        const std::streamsize n = pptr() - pbase();
+        setp(buf.data(), buf.data() + buf.size());
+        if(!n) return 0;
+        const auto start = std::chrono::steady_clock::now();
+        const std::streamsize ret = dest->sputn(buf.data(), n);
+        write_time += std::chrono::steady_clock::now() - start;
+        total += static_cast<size_t>(ret);
+        return ret == n ? 0 : -1;
+    }
+
+    std::streambuf *dest;
+    std::vector<char> buf;
+    size_t total;
+    size_t num_flushes;
+    std::chrono::duration<double> write_time;
+};
+
+// }}}1
+
 // {{{1 Main class
 
+template <size_t NumY=1>
+class StripChart;
+
 class Gnuplot :
     // Some setup needs to be done before obtaining the file descriptor that gets passed to
     // boost::iostreams::stream.  This is accomplished by using a multiple inheritance trick,
@@ -1699,6 +3715,7 @@ public:
         ),
         feedback(nullptr),
         tmp_files(new GnuplotTmpfileCollection()),
+        orig_buf(nullptr),
         debug_messages(false),
         transport_tmpfile(false)
     {
@@ -1717,6 +3734,7 @@ public:
         ),
         feedback(nullptr),
         tmp_files(new GnuplotTmpfileCollection()),
+        orig_buf(nullptr),
         debug_messages(false),
         transport_tmpfile(false)
     {
@@ -1734,6 +3752,11 @@ public:
             std::cerr << "ending gnuplot session" << std::endl;
         }
 
+#ifdef GNUPLOT_ENABLE_FEEDBACK
+        // The event callback must not run while this object is being torn down.
+        stopEventThread();
+#endif
+
         // FIXME - boost's close method calls close() on the file descriptor, but we need to
         // use sometimes use pclose instead.  For now, just skip calling boost's close and use
         // flush just in case.
@@ -1741,6 +3764,17 @@ public:
         // Wish boost had a pclose method...
         //close();
 
+        if(meter) {
+            rdbuf(meter->get_dest());
+        }
+
+        if(async_writer) {
+            // Wait for the writer thread to write everything that is queued.
+            async_writer.reset();
+            rdbuf(orig_buf);
+            async_buf.reset();
+        }
+
         fh_close();
 
         delete feedback;
@@ -1750,15 +3784,230 @@ public:
         transport_tmpfile = state;
     }
 
+    // Returns false if the stream has failed or gnuplot has exited.  Nothing is written, so
+    // this is safe to call when a write to a dead gnuplot would raise SIGPIPE.
+    bool isAlive() {
+        if(!good()) return false;
+#ifndef _WIN32
+        if(should_use_pclose) {
+            // The write end of a pipe reports an error once the reader has gone away.
+            pollfd pfd = { fh_fileno(), 0, 0 };
+            if(::poll(&pfd, 1, 0) > 0 && (pfd.revents & (POLLERR | POLLHUP | POLLNVAL))) {
+                return false;
+            }
+        }
+#endif
+        return true;
+    }
+
+    // Format long text data using this many threads (see default_text_format_threads).  Zero
+    // means use the default.
+    void setTextThreads(unsigned num_threads) {
+        set_text_format_threads(*this, num_threads);
+    }
+
+    // Put temporary files in this directory (empty means the system temp directory).  Only
+    // affects files created after this call.
+    void setTmpfileDirectory(const std::string &dir) {
+        tmp_files->set_directory(dir);
+    }
+
+    // Each plot slot of a PlotGroup sent with useTmpFile(true) cycles through `ring_size` files,
+    // so gnuplot may fall up to `ring_size-1` sends behind before a file it hasn't read yet is
+    // rewritten.  With useAsyncWriter(), `ring_size` must be larger than its `max_queue` (and is
+    // raised to that if needed).  Other temporary files (e.g. from file1d() with no filename)
+    // are limited to `max_files`, after which the oldest is rewritten; zero means no limit.
+    // Files that no longer fit after the pool is made smaller are kept until clearTmpfiles().
+    //
+    // By default a file is truncated and overwritten in place, so the same files are used for
+    // the whole session without creating or deleting any.  The price is that a gnuplot that
+    // falls further behind than the ring allows can read a partly written file.  With `staged`,
+    // each rewrite goes to a new file that is then renamed over the old one (see
+    // replace_file()): gnuplot never sees a partial file, only possibly a newer frame's data,
+    // but every rewrite creates and deletes a file.
+    void setTmpfilePool(size_t ring_size, size_t max_files=0, bool staged=false) {
+        tmp_files->set_pool_size(ring_size, max_files, staged);
+    }
+
+    GnuplotTmpfileStats tmpfileStats() const {
+        return tmp_files->get_stats();
+    }
+
+    // Put temporary files in /dev/shm, which is memory backed, so that data sent via tmpfiles
+    // never touches the disk.  Returns false (and uses the system temp directory) if /dev/shm
+    // isn't available.
+    bool useShmTmpfiles(bool state=true) {
+        bool use_shm = false;
+#ifdef GNUPLOT_USE_TMPFILE
+        boost::system::error_code ec;
+        use_shm = state && boost::filesystem::is_directory("/dev/shm", ec);
+#else
+        (void)state;
+#endif
+        setTmpfileDirectory(use_shm ? "/dev/shm" : "");
+        return use_shm;
+    }
+
     void clearTmpfiles() {
         // destructors will cause deletion
         tmp_files->clear();
+        // these referred to tmpfiles that are now gone
+        bin_datablocks.clear();
+    }
+
+    // Hand the output to a background thread, so that sending doesn't block while gnuplot
+    // is busy.  The output is cut into frames; frames are queued, up to `max_queue` of them,
+    // and `policy` decides what happens when the queue is full.
+    //
+    // With AsyncPolicy::Block each send*() call ends a frame, as does flushing the stream
+    // (std::flush or std::endl), so output goes out just as it would without the async writer,
+    // only without waiting for gnuplot.  With the dropping policies a frame has to hold a
+    // complete plot (command and data), otherwise a dropped frame would leave gnuplot reading
+    // data as commands.  So only send(PlotGroup) and endFrame() end a frame there; a plot with
+    // several '-' sources is sent as
+    //
+    //     gp << "plot '-' with lines, '-' with points\n";
+    //     gp.send1d(a);
+    //     gp.send1d(b);
+    //     gp.endFrame();
+    //
+    // and nothing reaches gnuplot until endFrame() (or wait_idle(), or a query) is called.
+    // Flushing the stream doesn't end a frame under these policies either, so commands that
+    // aren't followed by a send, such as `gp << "replot" << std::endl`, stay queued until then.
+    void useAsyncWriter(size_t max_queue=4, AsyncPolicy policy=AsyncPolicy::Block) {
+        if(async_writer) {
+            throw std::logic_error("async writer is already in use");
+        }
+        do_flush();
+        async_writer.reset(new GnuplotAsyncWriter(fh_fileno(), max_queue, policy));
+        // With useTmpFile(true) the queued frames refer to tmpfiles, which must not be replaced
+        // before gnuplot gets to them.
+        tmp_files->set_min_ring_size(std::max<size_t>(max_queue, 1) + 1);
+        async_buf.reset(new GnuplotAsyncBuf(*async_writer));
+        if(meter) {
+            orig_buf = meter->set_dest(async_buf.get());
+        } else {
+            orig_buf = rdbuf(async_buf.get());
+        }
+    }
+
+    // Hands everything written since the last frame to the writer (see useAsyncWriter).
+    // Without an async writer this just flushes the stream.
+    void endFrame() {
+        do_flush();
+    }
+
+    // Blocks until everything sent so far has been written to gnuplot.
+    void wait_idle() {
+        do_flush();
+        if(async_writer) async_writer->wait_idle();
+    }
+
+    // Number of frames discarded by the async writer.
+    size_t asyncDroppedFrames() const {
+        return async_writer ? async_writer->dropped() : 0;
+    }
+
+    // Waits for the writer thread of useAsyncWriter() to write everything that is queued, then
+    // stops it.  After this, writes go straight to gnuplot again.
+    void stopAsyncWriter() {
+        if(!async_writer) return;
+        do_flush();
+        async_writer.reset();
+        if(meter) {
+            meter->set_dest(orig_buf);
+        } else {
+            rdbuf(orig_buf);
+        }
+        async_buf.reset();
+        orig_buf = nullptr;
+        tmp_files->set_min_ring_size(1);
+    }
+
+    // Starts (or stops) keeping the counters returned by stats().  This puts a small buffer in
+    // front of the stream, which costs a copy of everything written.
+    void enableStats(bool state=true) {
+        if(state && !meter) {
+            do_flush();
+            meter.reset(new GnuplotMeterBuf(rdbuf()));
+            rdbuf(meter.get());
+            stats_base = GnuplotStats();
+            stats_base.tmpfiles_created = tmp_files->get_stats().created;
+        } else if(!state && meter) {
+            do_flush();
+            rdbuf(meter->get_dest());
+            meter.reset();
+        }
+    }
+
+    GnuplotStats stats() const {
+        GnuplotStats ret = stats_base;
+        if(meter) {
+            ret.bytes = meter->bytes();
+            ret.flushes = meter->flushes();
+            ret.write_seconds = meter->write_seconds();
+        }
+        ret.tmpfiles_created = tmp_files->get_stats().created - stats_base.tmpfiles_created;
+        return ret;
+    }
+
+    void resetStats() {
+        stats_base = GnuplotStats();
+        stats_base.tmpfiles_created = tmp_files->get_stats().created;
+        if(meter) meter->reset_counters();
+    }
+
+    // Calls `callback` after every send, with stats() as the argument (its last_send member
+    // describes the send that just happened).  This enables stats.  Pass nullptr to remove.
+    void onSend(std::function<void(const GnuplotStats &)> callback) {
+        send_callback = std::move(callback);
+        if(send_callback) enableStats();
+    }
+
+    // Undoes the settings made on this object (async writer, event subscription, tmpfile
+    // options, stats, text threads) and removes its tmpfiles, so that it behaves like a new
+    // session.  Gnuplot's own settings are not touched.  Used by GnuplotPool.
+    void resetClientState() {
+#ifdef GNUPLOT_ENABLE_FEEDBACK
+        unsubscribeEvents();
+#endif
+        stopAsyncWriter();
+        onSend(nullptr);
+        enableStats(false);
+        setTextThreads(0);
+        transport_tmpfile = false;
+        // This also puts back the default directory and pool sizes.
+        tmp_files.reset(new GnuplotTmpfileCollection());
+        bin_datablocks.clear();
+        stats_base = GnuplotStats();
+        do_flush();
     }
 
 public:
     void do_flush() {
+        flush_frame(true);
+    }
+
+private:
+    // The end of send() and sendBinary().  Under a dropping async policy the frame is left
+    // open, since the plot command may be waiting for more data (see useAsyncWriter).
+    void end_send() {
+        if(async_writer && async_writer->get_policy() != AsyncPolicy::Block) {
+            *this << std::flush;
+        } else {
+            do_flush();
+        }
+    }
+
+    // With an async writer, a frame that isn't `droppable` is written even with the dropping
+    // policies.
+    void flush_frame(bool droppable) {
         *this << std::flush;
-        fflush(wrapped_fh);
+        if(async_buf) {
+            async_buf->end_frame(droppable);
+        } else {
+            fflush(wrapped_fh);
+        }
     }
 
 private:
@@ -1766,8 +4015,57 @@ private:
         return tmp_files->make_tmpfile();
     }
 
+    // Calls `write` on the file, or on a temporary file if `filename` is empty, and returns the
+    // filename.  A temporary file may be one that was handed out before (see setTmpfilePool).
+    template <typename F>
+    std::string write_file(std::string filename, bool binary, F &&write) {
+        if(filename.empty()) {
+            filename = make_tmpfile();
+            rewrite_file(filename, binary, tmp_files->use_staging(), write);
+        } else {
+            std::ios_base::openmode mode = std::fstream::out;
+            if(binary) mode |= std::fstream::binary;
+            std::fstream fh(filename.c_str(), mode);
+            write(fh);
+        }
+        return filename;
+    }
+
+    size_t meter_bytes() const {
+        return meter ? meter->bytes() : 0;
+    }
+
+    // Runs `f`, which sends something to gnuplot and returns how many of the bytes it wrote
+    // were binary data, and records it in the stats.
+    template <typename F>
+    void metered_send(F &&f) {
+        if(!meter) {
+            f();
+            return;
+        }
+        const size_t bytes0 = meter->bytes();
+        const double write0 = meter->write_seconds();
+        const auto start = std::chrono::steady_clock::now();
+        const size_t binary_bytes = f();
+        const double seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+
+        GnuplotSendStats &s = stats_base.last_send;
+        s.bytes = meter->bytes() - bytes0;
+        s.binary = binary_bytes > 0;
+        s.write_seconds = meter->write_seconds() - write0;
+        s.serialize_seconds = std::max(0.0, seconds - s.write_seconds);
+        stats_base.sends++;
+        stats_base.binary_bytes += binary_bytes;
+        stats_base.text_bytes += s.bytes - binary_bytes;
+        stats_base.serialize_seconds += s.serialize_seconds;
+        if(send_callback) send_callback(stats());
+    }
+
     void set_stream_options(std::ostream &os) const
     {
+        // This precision is enough to round-trip a double.  FloatTextSender then prints the
+        // shortest representation that round-trips.
         os << std::defaultfloat << std::setprecision(17);  // refer <iomanip>
     }
 
@@ -1780,16 +4078,24 @@ public:
 
     template <typename T, typename OrganizationMode>
     Gnuplot &send(const T &arg, OrganizationMode) {
-        top_level_array_sender(*this, arg, OrganizationMode(), ModeText());
-        *this << "e" << std::endl; // gnuplot's "end of array" token
-        do_flush(); // probably not really needed, but doesn't hurt
+        metered_send([&]() {
+            top_level_array_sender(*this, arg, OrganizationMode(), ModeText());
+            *this << "e\n"; // gnuplot's "end of array" token
+            end_send();
+            return size_t(0);
+        });
         return *this;
     }
 
     template <typename T, typename OrganizationMode>
     Gnuplot &sendBinary(const T &arg, OrganizationMode) {
-        top_level_array_sender(*this, arg, OrganizationMode(), ModeBinary());
-        do_flush(); // probably not really needed, but doesn't hurt
+        metered_send([&]() {
+            const size_t bytes0 = meter_bytes();
+            top_level_array_sender(*this, arg, OrganizationMode(), ModeBinary());
+            const size_t binary_bytes = meter_bytes() - bytes0;
+            end_send(); // probably not really needed, but doesn't hurt
+            return binary_bytes;
+        });
         return *this;
     }
 
@@ -1812,35 +4118,186 @@ public:
         return ret;
     }
 
-    // NOTE: empty filename makes temporary file
-    template <typename T, typename OrganizationMode>
-    std::string file(const T &arg, std::string filename, OrganizationMode) {
-        if(filename.empty()) filename = make_tmpfile();
-        std::fstream tmp_stream(filename.c_str(), std::fstream::out);
-        tmp_stream.copyfmt(*this);
-        top_level_array_sender(tmp_stream, arg, OrganizationMode(), ModeText());
-        tmp_stream.close();
+    // NOTE: empty filename makes temporary file
+    template <typename T, typename OrganizationMode>
+    std::string file(const T &arg, std::string filename, OrganizationMode) {
+        filename = write_file(filename, false, [&](std::ostream &os) {
+            os.copyfmt(*this);
+            top_level_array_sender(os, arg, OrganizationMode(), ModeText());
+        });
+
+        std::ostringstream cmdline;
+        // FIXME - hopefully filename doesn't contain quotes or such...
+        cmdline << " '" << filename << "' ";
+        return cmdline.str();
+    }
+
+    // NOTE: empty filename makes temporary file
+    template <typename T, typename OrganizationMode>
+    std::string binaryFile(const T &arg, std::string filename, const std::string &arr_or_rec, OrganizationMode) {
+        filename = write_file(filename, true, [&](std::ostream &os) {
+            top_level_array_sender(os, arg, OrganizationMode(), ModeBinary());
+        });
+
+        std::ostringstream cmdline;
+        // FIXME - hopefully filename doesn't contain quotes or such...
+        cmdline << " '" << filename << "' binary" << binfmt(arg, arr_or_rec, OrganizationMode());
+        return cmdline.str();
+    }
+
+    // Uploads the data to a gnuplot datablock named `$name`, unless the same data was already
+    // uploaded under that name.  Returns the name, for use in a plot command.  Since the upload
+    // is written to the stream, this must be called before the plot command is started (not
+    // in the middle of `gp << "plot" << ...`).  The upload is never dropped by the async
+    // writer, since later frames only refer to it by name.
+    template <typename T, typename OrganizationMode>
+    std::string datablock(const T &arg, const std::string &name, OrganizationMode) {
+        check_datablock_name(name);
+        std::ostringstream tmp;
+        tmp.copyfmt(*this);
+        top_level_array_sender(tmp, arg, OrganizationMode(), ModeText());
+        const std::string data = tmp.str();
+        const std::string handle = " $" + name + " ";
+
+        const uint64_t hash = fnv1a_hash(data);
+        auto it = datablocks.find(name);
+        if(it != datablocks.end() && it->second.hash == hash) {
+            return handle;
+        }
+
+        metered_send([&]() {
+            *this << "$" << name << " << EOD\n";
+            *this << data;
+            *this << "EOD\n";
+            flush_frame(false);
+            return size_t(0);
+        });
+        datablocks[name] = DatablockEntry{hash, handle};
+        return handle;
+    }
+
+    // Like datablock(), but the data goes to a binary tmpfile.  Each name has a single file,
+    // which changed data replaces (see replace_file()), so a plot that gnuplot is still
+    // reading keeps the old data.  Returns the filename and binary format, for use in a plot
+    // command.
+    template <typename T, typename OrganizationMode>
+    std::string binaryDatablock(const T &arg, const std::string &name, const std::string &arr_or_rec, OrganizationMode) {
+        check_datablock_name(name);
+        std::ostringstream tmp;
+        top_level_array_sender(tmp, arg, OrganizationMode(), ModeBinary());
+        const std::string fmt = binfmt(arg, arr_or_rec, OrganizationMode());
+
+        const uint64_t hash = fnv1a_hash(tmp.str(), fnv1a_hash(fmt));
+        auto it = bin_datablocks.find(name);
+        if(it != bin_datablocks.end() && it->second.hash == hash) {
+            return it->second.handle;
+        }
+
+        const std::string filename = tmp_files->named_tmpfile(name);
+        const std::string data = tmp.str();
+        replace_file(filename, true, [&](std::ostream &os) {
+            os.write(data.data(), static_cast<std::streamsize>(data.size()));
+        });
+
+        const std::string handle = " " + quote_string(filename) + " binary" + fmt;
+        bin_datablocks[name] = DatablockEntry{hash, handle};
+        return handle;
+    }
+
+    // Binary format for sending 2D data (an ImageView or any other 2D container) as an image,
+    // for use as `plot '-' ` + imageFmt(img) + ` with image` followed by sendImage(img).
+    // Besides the size and format this sets dx, dy, and origin from `geom`.
+    template <typename T>
+    std::string imageFmt(const T &arg, const ImageGeometry &geom=ImageGeometry()) {
+        std::ostringstream cmdline;
+        cmdline.copyfmt(*this);
+        cmdline << "binary" << binfmt(arg, "array", Mode2D())
+            << "dx=" << geom.dx << " dy=" << geom.dy
+            << " origin=(" << geom.x0 << "," << geom.y0 << ") ";
+        return cmdline.str();
+    }
+
+    // Sends the pixels of 2D data in the order expected by imageFmt().  This is just
+    // sendBinary2d(), which sends rows (or whole images) with single writes when the storage
+    // allows.
+    template <typename T>
+    Gnuplot &sendImage(const T &arg) {
+        return sendBinary(arg, Mode2D());
+    }
+
+    // Writes 2D data of scalars to a file in gnuplot's `binary matrix` format (single precision,
+    // with the x and y coordinates from `geom` in the first row and column) and returns the
+    // filename and format, for use as `plot` + binMatrixFile(m) + `with image`.  An empty
+    // filename makes a temporary file.  Throws std::length_error if the data is empty or the
+    // rows are different lengths.
+    template <typename T>
+    std::string binMatrixFile(const T &arg, std::string filename="", const ImageGeometry &geom=ImageGeometry()) {
+        static_assert(ArrayTraits<T>::depth == 2, "binMatrixFile needs 2D data of scalars");
+        filename = write_file(filename, true, [&](std::ostream &os) {
+            const auto write = [&](const std::vector<float> &v) {
+                os.write(reinterpret_cast<const char *>(v.data()),
+                    static_cast<std::streamsize>(v.size() * sizeof(float)));
+            };
+            std::vector<float> line;
+            size_t width = 0;
+            size_t y = 0;
+            for(auto rows = ArrayTraits<T>::get_range(arg); !rows.is_end(); rows.inc(), y++) {
+                line.clear();
+                line.push_back(static_cast<float>(geom.y0 + static_cast<double>(y) * geom.dy));
+                for(auto cols = rows.deref_subiter(); !cols.is_end(); cols.inc()) {
+                    line.push_back(static_cast<float>(cols.deref()));
+                }
+                if(!y) {
+                    // The first line holds the number of columns and the x coordinates.
+                    width = line.size() - 1;
+                    if(!width) throw std::length_error("binMatrixFile: empty matrix");
+                    std::vector<float> header(width + 1);
+                    header[0] = static_cast<float>(width);
+                    for(size_t x=0; x<width; x++) {
+                        header[x+1] = static_cast<float>(geom.x0 + static_cast<double>(x) * geom.dx);
+                    }
+                    write(header);
+                } else if(line.size() - 1 != width) {
+                    throw std::length_error("rows were different lengths");
+                }
+                write(line);
+            }
+            if(!y) throw std::length_error("binMatrixFile: empty matrix");
+        });
+
+        return " " + quote_string(filename) + " binary matrix ";
+    }
 
-        std::ostringstream cmdline;
-        // FIXME - hopefully filename doesn't contain quotes or such...
-        cmdline << " '" << filename << "' ";
-        return cmdline.str();
+    // Forget which data has been uploaded, so that the next datablock call re-sends it.  Needed
+    // if gnuplot's datablocks were changed behind our back (e.g. by `reset session`).
+    void clearDatablocks() {
+        datablocks.clear();
+        bin_datablocks.clear();
     }
 
-    // NOTE: empty filename makes temporary file
-    template <typename T, typename OrganizationMode>
-    std::string binaryFile(const T &arg, std::string filename, const std::string &arr_or_rec, OrganizationMode) {
-        if(filename.empty()) filename = make_tmpfile();
-        std::fstream tmp_stream(filename.c_str(), std::fstream::out | std::fstream::binary);
-        top_level_array_sender(tmp_stream, arg, OrganizationMode(), ModeBinary());
-        tmp_stream.close();
+private:
+    struct DatablockEntry {
+        uint64_t hash;
+        std::string handle;
+    };
 
-        std::ostringstream cmdline;
-        // FIXME - hopefully filename doesn't contain quotes or such...
-        cmdline << " '" << filename << "' binary" << binfmt(arg, arr_or_rec, OrganizationMode());
-        return cmdline.str();
+    static uint64_t fnv1a_hash(const std::string &s, uint64_t h=14695981039346656037ULL) {
+        for(unsigned char c : s) {
+            h ^= c;
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+
+    static void check_datablock_name(const std::string &name) {
+        bool ok = !name.empty() && !std::isdigit(static_cast<unsigned char>(name[0]));
+        for(unsigned char c : name) {
+            if(!(std::isalnum(c) || c == '_')) ok = false;
+        }
+        if(!ok) throw std::logic_error("invalid datablock name: "+name);
     }
 
+public:
 // }}}2
 
 // {{{2 Deprecated data sending interface that guesses an appropriate OrganizationMode.  This is here
@@ -1877,6 +4334,10 @@ public:
     template <typename T> Gnuplot &send1d_colmajor(const T &arg) { return send(arg, Mode1DUnwrap()); }
     template <typename T> Gnuplot &send2d_colmajor(const T &arg) { return send(arg, Mode2DUnwrap()); }
 
+    // Sends at most about `target_points` points, see decimate_minmax().
+    template <typename T> Gnuplot &send1d_decimated      (const T &arg, size_t target_points) { return send(decimate_minmax(arg, target_points), Mode1D()); }
+    template <typename T> Gnuplot &sendBinary1d_decimated(const T &arg, size_t target_points) { return sendBinary(decimate_minmax(arg, target_points), Mode1D()); }
+
     template <typename T> Gnuplot &sendBinary1d         (const T &arg) { return sendBinary(arg, Mode1D      ()); }
     template <typename T> Gnuplot &sendBinary2d         (const T &arg) { return sendBinary(arg, Mode2D      ()); }
     template <typename T> Gnuplot &sendBinary1d_colmajor(const T &arg) { return sendBinary(arg, Mode1DUnwrap()); }
@@ -1897,6 +4358,16 @@ public:
     template <typename T> std::string binFile1d_colmajor(const T &arg, const std::string &arr_or_rec, const std::string &filename="") { return binaryFile(arg, filename, arr_or_rec,  Mode1DUnwrap()); }
     template <typename T> std::string binFile2d_colmajor(const T &arg, const std::string &arr_or_rec, const std::string &filename="") { return binaryFile(arg, filename, arr_or_rec,  Mode2DUnwrap()); }
 
+    template <typename T> std::string datablock1d         (const T &arg, const std::string &name) { return datablock(arg, name, Mode1D      ()); }
+    template <typename T> std::string datablock2d         (const T &arg, const std::string &name) { return datablock(arg, name, Mode2D      ()); }
+    template <typename T> std::string datablock1d_colmajor(const T &arg, const std::string &name) { return datablock(arg, name, Mode1DUnwrap()); }
+    template <typename T> std::string datablock2d_colmajor(const T &arg, const std::string &name) { return datablock(arg, name, Mode2DUnwrap()); }
+
+    template <typename T> std::string binDatablock1d         (const T &arg, const std::string &name, const std::string &arr_or_rec) { return binaryDatablock(arg, name, arr_or_rec, Mode1D      ()); }
+    template <typename T> std::string binDatablock2d         (const T &arg, const std::string &name, const std::string &arr_or_rec) { return binaryDatablock(arg, name, arr_or_rec, Mode2D      ()); }
+    template <typename T> std::string binDatablock1d_colmajor(const T &arg, const std::string &name, const std::string &arr_or_rec) { return binaryDatablock(arg, name, arr_or_rec, Mode1DUnwrap()); }
+    template <typename T> std::string binDatablock2d_colmajor(const T &arg, const std::string &name, const std::string &arr_or_rec) { return binaryDatablock(arg, name, arr_or_rec, Mode2DUnwrap()); }
+
 // }}}2
 
 #ifdef GNUPLOT_ENABLE_FEEDBACK
@@ -1908,22 +4379,271 @@ public:
         double &mx, double &my, int &mb,
         std::string msg="Click Mouse!"
     ) {
+        getMouse(mx, my, mb, msg, -1);
+    }
+
+    // Like above, but gives up after `timeout_ms` milliseconds (negative means wait forever)
+    // and returns false.  In that case gnuplot is still waiting for the click, and the next
+    // call of getMouse() or try_getMouse() will pick up the answer rather than asking again.
+    bool getMouse(
+        double &mx, double &my, int &mb,
+        const std::string &msg, int timeout_ms
+    ) {
+        if(!mouse_pending) {
+            requestMouse(msg);
+        }
+        std::string line;
+        if(!readFeedback(line, timeout_ms)) {
+            return false;
+        }
+        mouse_pending = false;
+        std::istringstream tmp(line);
+        if(!(tmp >> mx >> my >> mb)) {
+            throw std::runtime_error("could not parse reply: "+line);
+        }
+        return true;
+    }
+
+    // Returns true, and sets the mouse position and button, if a click has been received.
+    // Otherwise, asks gnuplot for a click (if not already done) and returns false without
+    // waiting.
+    bool try_getMouse(
+        double &mx, double &my, int &mb,
+        const std::string &msg="Click Mouse!"
+    ) {
+        return getMouse(mx, my, mb, msg, 0);
+    }
+
+    // Evaluates `expr` with gnuplot's print command and returns the lines it printed.  For
+    // example `query("GPVAL_X_MIN, GPVAL_X_MAX")`.  Throws std::runtime_error if gnuplot
+    // doesn't answer within `timeout_ms` milliseconds (negative means wait forever).
+    std::vector<std::string> query(const std::string &expr, int timeout_ms=-1) {
+        if(mouse_pending) {
+            throw std::logic_error("gnuplot is still waiting for a mouse click");
+        }
+        allocFeedback();
+        const auto start = std::chrono::steady_clock::now();
+        const auto deadline = start + std::chrono::milliseconds(timeout_ms);
+        const auto remaining = [&]() {
+            if(timeout_ms < 0) return -1;
+            return static_cast<int>(std::max<long long>(0,
+                std::chrono::duration_cast<std::chrono::milliseconds>(
+                    deadline - std::chrono::steady_clock::now()).count()));
+        };
+
+        // Lines left over from a query that timed out.
+        std::string line;
+        while(!stale_sentinel.empty()) {
+            if(!nextFeedbackLine(line, remaining())) {
+                throw std::runtime_error("timed out waiting for gnuplot");
+            }
+            if(line == stale_sentinel) stale_sentinel.clear();
+        }
+
+        // The end of the output is marked by printing a unique string.
+        const std::string sentinel = "gnuplot-iostream-end-" + std::to_string(++num_queries);
+        *this << "print " << expr << "\n";
+        *this << "print \"" << sentinel << "\"\n";
+        do_flush();
+
+        std::vector<std::string> ret;
+        for(;;) {
+            if(!nextFeedbackLine(line, remaining())) {
+                stale_sentinel = sentinel;
+                throw std::runtime_error("timed out waiting for gnuplot");
+            }
+            if(line == sentinel) break;
+            ret.push_back(line);
+        }
+        last_feedback_latency = std::chrono::steady_clock::now() - start;
+        record_feedback_latency();
+        return ret;
+    }
+
+    // Calls `callback` for every key press, mouse click, and window close reported by
+    // gnuplot, until unsubscribeEvents() is called.  `keys` lists the keys to report, using
+    // gnuplot's names ("a", "space", "Escape", "F1", ...).  Clicks are reported by binding
+    // "Button1" to "Button3", so whether they arrive depends on the terminal.  This installs
+    // gnuplot `bind` commands, which replace any bindings of the same keys.  Note that gnuplot
+    // has no binding for zooming; use query("GPVAL_X_MIN, GPVAL_X_MAX") to get the ranges.
+    //
+    // The callback runs on a background thread that reads the feedback channel.  getMouse()
+    // and query() still work while subscribed.  Sending commands to gnuplot from inside the
+    // callback is only safe if no other thread is writing to this Gnuplot object at the same
+    // time.
+    void subscribeEvents(
+        std::function<void(const GnuplotEvent &)> callback,
+        const std::vector<std::string> &keys = {},
+        bool buttons = true
+    ) {
+        unsubscribeEvents();
+        allocFeedback();
+
+        const auto bind = [this](const std::string &key, const std::string &what) {
+            *this << "bind \"" << key << "\" 'print \"" << event_tag << what << "\", "
+                << "(exists(\"MOUSE_X\") ? MOUSE_X : NaN), (exists(\"MOUSE_Y\") ? MOUSE_Y : NaN)'\n";
+            bound_keys.push_back(key);
+        };
+        *this << "set mouse\n";
+        for(const std::string &key : keys) {
+            if(key.empty() || key.find_first_of("\"' \t\n") != std::string::npos) {
+                throw std::invalid_argument("invalid key name: '"+key+"'");
+            }
+            bind(key, "key "+key);
+        }
+        if(buttons) {
+            for(int b=1; b<=3; b++) {
+                bind("Button"+std::to_string(b), "button "+std::to_string(b));
+            }
+        }
+        bind("Close", "close -");
+        do_flush();
+
+        event_callback = std::move(callback);
+        event_stop = false;
+        event_error = nullptr;
+        event_thread = std::thread([this]() { eventLoop(); });
+    }
+
+    // Stops delivering events and removes the bindings installed by subscribeEvents().
+    // Must not be called from inside the callback.
+    void unsubscribeEvents() {
+        if(!event_thread.joinable()) return;
+        stopEventThread();
+        for(const std::string &key : bound_keys) {
+            *this << "bind \"" << key << "\" \"\"\n";
+        }
+        bound_keys.clear();
+        do_flush();
+        event_callback = nullptr;
+    }
+
+    // Time taken by the most recent successful getMouse() or query() round trip.  For
+    // getMouse() this includes the time waiting for the user to click.
+    double lastFeedbackSeconds() const {
+        return last_feedback_latency.count();
+    }
+
+private:
+    void requestMouse(const std::string &msg) {
         allocFeedback();
 
         *this << "set mouse" << std::endl;
         *this << "pause mouse \"" << msg << "\\n\"" << std::endl;
         *this << "if (exists(\"MOUSE_X\")) print MOUSE_X, MOUSE_Y, MOUSE_BUTTON; else print 0, 0, -1;" << std::endl;
+        do_flush();
+        mouse_pending = true;
+        mouse_request_time = std::chrono::steady_clock::now();
+    }
+
+    bool readFeedback(std::string &line, int timeout_ms) {
         if(debug_messages) {
-            std::cerr << "begin scanf" << std::endl;
+            std::cerr << "begin read" << std::endl;
         }
-        if(3 != fscanf(feedback->handle(), "%50lf %50lf %50d", &mx, &my, &mb)) {
-            throw std::runtime_error("could not parse reply");
+        bool ret = nextFeedbackLine(line, timeout_ms);
+        if(ret) {
+            last_feedback_latency = std::chrono::steady_clock::now() - mouse_request_time;
+            record_feedback_latency();
         }
         if(debug_messages) {
-            std::cerr << "end scanf" << std::endl;
+            std::cerr << "end read" << std::endl;
+        }
+        return ret;
+    }
+
+    void record_feedback_latency() {
+        stats_base.feedback_round_trips++;
+        stats_base.feedback_seconds += last_feedback_latency.count();
+    }
+
+    // Reads the next line of feedback that isn't an event.  While events are subscribed the
+    // reader thread owns the channel and hands other lines over through a queue.
+    bool nextFeedbackLine(std::string &line, int timeout_ms) {
+        if(!event_thread.joinable()) {
+            for(;;) {
+                if(!feedback->read_line(line, timeout_ms)) return false;
+                // Events left over from an earlier subscription.
+                if(line.compare(0, event_tag.size(), event_tag) != 0) return true;
+            }
+        }
+
+        std::unique_lock<std::mutex> lock(event_mutex);
+        const auto ready = [this]() { return !feedback_lines.empty() || event_error; };
+        if(timeout_ms < 0) {
+            event_cond.wait(lock, ready);
+        } else if(!event_cond.wait_for(lock, std::chrono::milliseconds(timeout_ms), ready)) {
+            return false;
+        }
+        if(feedback_lines.empty()) {
+            std::rethrow_exception(event_error);
+        }
+        line = std::move(feedback_lines.front());
+        feedback_lines.pop_front();
+        return true;
+    }
+
+    bool mouse_pending = false;
+    std::chrono::steady_clock::time_point mouse_request_time;
+    std::chrono::duration<double> last_feedback_latency{0};
+    std::string stale_sentinel;
+    size_t num_queries = 0;
+
+    void eventLoop() {
+        std::string line;
+        try {
+            while(!event_stop) {
+                // Wake up now and then to see whether we have been asked to stop.
+                if(!feedback->read_line(line, 100)) continue;
+                if(line.compare(0, event_tag.size(), event_tag) != 0) {
+                    std::lock_guard<std::mutex> lock(event_mutex);
+                    feedback_lines.push_back(std::move(line));
+                    event_cond.notify_all();
+                    continue;
+                }
+
+                std::istringstream tmp(line.substr(event_tag.size()));
+                std::string type, name, x, y;
+                if(!(tmp >> type >> name >> x >> y)) continue;
+                GnuplotEvent ev;
+                if(type == "key") {
+                    ev.type = GnuplotEvent::Key;
+                    ev.key = name;
+                } else if(type == "button") {
+                    ev.type = GnuplotEvent::Button;
+                    ev.button = std::atoi(name.c_str());
+                } else {
+                    ev.type = GnuplotEvent::Close;
+                }
+                // Gnuplot prints "NaN" when the mouse isn't over a plot, which strtod accepts.
+                ev.x = std::strtod(x.c_str(), nullptr);
+                ev.y = std::strtod(y.c_str(), nullptr);
+                event_callback(ev);
+            }
+        } catch(...) {
+            // Let a waiting getMouse() or query() know that no more lines are coming.
+            std::lock_guard<std::mutex> lock(event_mutex);
+            event_error = std::current_exception();
+            event_cond.notify_all();
+        }
+    }
+
+    void stopEventThread() {
+        if(event_thread.joinable()) {
+            event_stop = true;
+            event_thread.join();
         }
     }
 
+    const std::string event_tag = "gnuplot-iostream-event ";
+    std::function<void(const GnuplotEvent &)> event_callback;
+    std::vector<std::string> bound_keys;
+    std::thread event_thread;
+    std::atomic<bool> event_stop{false};
+    std::mutex event_mutex;
+    std::condition_variable event_cond;
+    std::deque<std::string> feedback_lines;
+    std::exception_ptr event_error;
+
 private:
     void allocFeedback() {
         if(!feedback) {
@@ -1953,21 +4673,32 @@ public:
         return PlotGroup("splot");
     }
 
+    Gnuplot &send(const PlotGroup &&plot_group) {
+        return send(plot_group);
+    }
+
     Gnuplot &send(const PlotGroup &plot_group) {
-        return send(PlotGroup(plot_group));
+        metered_send([&]() { return send_plot_group(plot_group); });
+        return *this;
     }
 
-    Gnuplot &send(const PlotGroup &&plot_group) {
+private:
+    // Returns the number of bytes of binary data sent.
+    size_t send_plot_group(const PlotGroup &plot_group) {
         for(const std::string &s : plot_group.preamble_lines) {
             *this << s << "\n";
         }
 
-        std::vector<PlotData> spl = std::move(plot_group.plots);
+        // This copy is cheap since PlotData shares its (already serialized) data.
+        std::vector<PlotData> spl = plot_group.plots;
 
         if(transport_tmpfile) {
+            // Each plot of the group gets its own ring of files, which are reused by later
+            // sends rather than creating new files for every frame (see setTmpfilePool).
+            size_t slot = 0;
             for(size_t i=0; i<spl.size(); i++) {
                 if(spl[i].isInline()) {
-                    spl[i].file(make_tmpfile());
+                    spl[i].file(tmp_files->slot_tmpfile(slot++), tmp_files->use_staging());
                 }
             }
         }
@@ -1990,26 +4721,43 @@ public:
             if(i) *this << ", ";
             *this << spl[i].plotCmd();
         }
-        *this << std::endl;
+        *this << "\n";
 
+        size_t binary_bytes = 0;
         for(const PlotData &sp : spl) {
             if(sp.isInline()) {
-                *this << sp.getData();
+                const size_t bytes0 = meter_bytes();
+                sp.write_data(*this);
                 if(sp.isText()) {
-                    *this << "e" << std::endl; // gnuplot's "end of array" token
+                    *this << "e\n"; // gnuplot's "end of array" token
+                } else {
+                    binary_bytes += meter_bytes() - bytes0;
                 }
             }
         }
 
         do_flush();
 
-        return *this;
+        return binary_bytes;
     }
 // }}}2
 
 private:
     GnuplotFeedback *feedback;
     std::shared_ptr<GnuplotTmpfileCollection> tmp_files;
+    std::unique_ptr<GnuplotAsyncWriter> async_writer;
+    std::unique_ptr<GnuplotAsyncBuf> async_buf;
+    std::streambuf *orig_buf;
+    std::unique_ptr<GnuplotMeterBuf> meter;
+    // The counters that aren't kept by the meter.
+    GnuplotStats stats_base;
+    std::function<void(const GnuplotStats &)> send_callback;
+    std::map<std::string, DatablockEntry> datablocks;
+    std::map<std::string, DatablockEntry> bin_datablocks;
+
+    // Uses the tmpfiles and metered_send().
+    template <size_t NumY>
+    friend class StripChart;
 public:
     bool debug_messages;
     bool transport_tmpfile;
@@ -2025,6 +4773,460 @@ inline Gnuplot &operator<<(Gnuplot &gp, PlotGroup &&sp) {
 
 // }}}1
 
+// {{{1 StripChart
+//
+// A plot of the most recent `capacity` samples of a stream of data, such as live telemetry.
+// Samples are added with push(x, y1, ..., yN) into a ring buffer, and update() redraws the plot
+// (sending only what is in the buffer) at most `max_fps` times per second.  Each of the NumY
+// columns is drawn as a separate curve against x.  The buffer is written once per redraw, to a
+// binary tmpfile that all of the curves read.  The file is deleted with the chart, after which
+// gnuplot can no longer replot it.
+
+template <size_t NumY>
+class StripChart {
+public:
+    typedef std::array<double, NumY+1> row_type;
+
+    StripChart(Gnuplot &_gp, size_t _capacity, double _max_fps=0) :
+        gp(_gp), capacity(_capacity), max_fps(_max_fps), head(0), count(0), dirty(false),
+        tmpfile_name("StripChart#" + std::to_string(next_id()))
+    {
+        static_assert(NumY > 0, "need at least one column of y values");
+        static_assert(sizeof(row_type) == (NumY+1)*sizeof(double), "unexpected padding");
+        if(!capacity) throw std::logic_error("StripChart capacity must be positive");
+        ring.resize(capacity);
+        for(size_t i=0; i<NumY; i++) specs[i] = "with lines notitle";
+    }
+
+    StripChart(const StripChart &) = delete;
+    const StripChart& operator=(const StripChart &) = delete;
+
+    ~StripChart() {
+        gp.tmp_files->drop_named_tmpfile(tmpfile_name);
+    }
+
+    // The plot style of the curve for the i'th column of y values (e.g. "with lines title 'y'").
+    StripChart &plotspec(size_t i, const std::string &spec) {
+        specs.at(i) = spec;
+        return *this;
+    }
+
+    template <typename... Y>
+    void push(double x, Y... y) {
+        static_assert(sizeof...(Y) == NumY, "wrong number of y values");
+        ring[(head + count) % capacity] = row_type{{ x, static_cast<double>(y)... }};
+        if(count < capacity) {
+            ++count;
+        } else {
+            head = (head + 1) % capacity;
+        }
+        dirty = true;
+    }
+
+    // Redraws if there is new data and the last redraw wasn't too recent.  Returns whether it
+    // redrew.
+    bool update() {
+        if(!dirty) return false;
+        if(max_fps > 0 && last_draw) {
+            const double elapsed = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - *last_draw).count();
+            if(elapsed < 1.0 / max_fps) return false;
+        }
+        redraw();
+        return true;
+    }
+
+    void redraw() {
+        dirty = false;
+        last_draw = std::chrono::steady_clock::now();
+
+        gp.metered_send([&]() {
+            if(!count) {
+                // Otherwise the last curve would stay on the screen.
+                gp << "clear\n";
+                gp.do_flush();
+                return size_t(0);
+            }
+
+            // The data is in at most two pieces, since the ring buffer may wrap around.
+            const std::string filename = gp.tmp_files->named_tmpfile(tmpfile_name);
+            const size_t first = std::min(count, capacity - head);
+            replace_file(filename, true, [&](std::ostream &os) {
+                write_rows(os, &ring[head], first);
+                write_rows(os, &ring[0], count - first);
+            });
+
+            // The format doesn't change, only the number of records.
+            if(header.empty()) {
+                header = " binary format='";
+                for(size_t i=0; i<=NumY; i++) header += "%double";
+                header += "' record=(";
+            }
+            const std::string num = std::to_string(count);
+            std::string cmd = "plot";
+            for(size_t i=0; i<NumY; i++) {
+                if(i) cmd += ",";
+                cmd += " " + (i ? std::string("''") : quote_string(filename)) +
+                    header + num + ") using 1:" + std::to_string(i+2) + " " + specs[i];
+            }
+            gp << cmd << "\n";
+            gp.do_flush();
+            // The data went to the file rather than through the stream.
+            return size_t(0);
+        });
+    }
+
+    void clear() {
+        head = count = 0;
+        dirty = true;
+    }
+
+    size_t size() const { return count; }
+
+private:
+    // Tells charts apart in the names of their tmpfiles, which (unlike the address of the chart)
+    // are never used again by a later chart.
+    static uint64_t next_id() {
+        static std::atomic<uint64_t> last(0);
+        return ++last;
+    }
+
+    static void write_rows(std::ostream &os, const row_type *p, size_t n) {
+        os.write(reinterpret_cast<const char *>(p), static_cast<std::streamsize>(n * sizeof(row_type)));
+    }
+
+    Gnuplot &gp;
+    const size_t capacity;
+    const double max_fps;
+    std::vector<row_type> ring;
+    size_t head, count;
+    bool dirty;
+    std::array<std::string, NumY> specs;
+    std::string header;
+    std::optional<std::chrono::steady_clock::time_point> last_draw;
+    const std::string tmpfile_name;
+};
+
+// }}}1
+
+// {{{1 GnuplotPool
+
+// One plot for GnuplotPool::render_batch().
+struct GnuplotBatchJob {
+    PlotGroup plots;
+    // Given to `set terminal`, e.g. "pngcairo size 800,600" or "svg".
+    std::string terminal;
+    // Given to `set output`.
+    std::string output;
+    // Seconds to wait for gnuplot to finish the job (only with GNUPLOT_ENABLE_FEEDBACK, see
+    // GnuplotPool::render_batch).  Zero means wait forever.
+    double timeout = 60;
+};
+
+struct GnuplotBatchResult {
+    bool ok = false;
+    // The exception message, or gnuplot's error message, if !ok.
+    std::string error;
+    // Time from sending the job until gnuplot finished it (see GnuplotPool::render_batch).
+    double seconds = 0;
+    // Which of the worker threads ran the job (0 to size()-1).
+    size_t worker = 0;
+};
+
+// A set of gnuplot processes that are started once and then lent out, to avoid the cost of
+// starting gnuplot (and initializing its terminal) for each of many plots:
+//
+//     GnuplotPool pool(4);
+//     for(...) {
+//         GnuplotPool::Lease gp = pool.acquire();
+//         *gp << "set terminal pngcairo\nset output 'plot.png'\n";
+//         *gp << "plot sin(x)\n";
+//     } // The session goes back to the pool here.
+//
+// When a session is returned, the output file is closed (`unset output`) and gnuplot's
+// settings are cleared with `reset`.  The terminal is kept, as are user variables and
+// datablocks.  Settings made on the Gnuplot object itself (such as useAsyncWriter() or
+// useTmpFile()) are undone with resetClientState().  A process that has died is replaced by a
+// new one.  If the new process can't be started, the dead session stays in the pool and
+// acquire() throws (the next acquire() tries again).  Leases can be taken from several threads
+// at once.  The pool must outlive its leases.
+//
+// Writing to a gnuplot that has just died raises SIGPIPE.  The pool never writes to a process
+// that it knows to be dead, but a process can die while it is lent out, so programs that
+// need to survive that should ignore SIGPIPE.
+class GnuplotPool {
+public:
+    class Lease {
+    public:
+        Lease() : pool(nullptr) { }
+
+        Lease(Lease &&other) :
+            pool(other.pool), gp(std::move(other.gp))
+        {
+            other.pool = nullptr;
+        }
+
+        Lease &operator=(Lease &&other) {
+            if(this != &other) {
+                release();
+                pool = other.pool;
+                gp = std::move(other.gp);
+                other.pool = nullptr;
+            }
+            return *this;
+        }
+
+        ~Lease() {
+            release();
+        }
+
+        Gnuplot &operator*() const { return *gp; }
+        Gnuplot *operator->() const { return gp.get(); }
+        Gnuplot *get() const { return gp.get(); }
+        explicit operator bool() const { return bool(gp); }
+
+        // Returns the session to the pool before the lease goes out of scope.
+        void release() {
+            if(gp) {
+                pool->give_back(std::move(gp));
+            }
+            pool = nullptr;
+        }
+
+    private:
+        friend class GnuplotPool;
+
+        Lease(GnuplotPool *_pool, std::unique_ptr<Gnuplot> _gp) :
+            pool(_pool), gp(std::move(_gp)) { }
+
+        GnuplotPool *pool;
+        std::unique_ptr<Gnuplot> gp;
+    };
+
+    // Starts `size` gnuplot processes using `cmd` (see the Gnuplot constructor).
+    explicit GnuplotPool(size_t size, const std::string &_cmd="") :
+        cmd(_cmd),
+        num_total(size),
+        num_respawned(0)
+    {
+        if(size == 0) {
+            throw std::invalid_argument("GnuplotPool needs at least one process");
+        }
+        for(size_t i=0; i<size; i++) {
+            idle.push_back(std::make_unique<Gnuplot>(cmd));
+        }
+    }
+
+    GnuplotPool(const GnuplotPool &) = delete;
+    const GnuplotPool& operator=(const GnuplotPool &) = delete;
+
+    // Waits until a session is free and lends it out.
+    Lease acquire() {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [this]() { return !idle.empty(); });
+        return take(lock);
+    }
+
+    // Like acquire(), but returns an empty lease if no session is free.
+    Lease try_acquire() {
+        std::unique_lock<std::mutex> lock(mutex);
+        if(idle.empty()) return Lease();
+        return take(lock);
+    }
+
+    size_t size() const {
+        return num_total;
+    }
+
+    // Number of sessions not currently lent out.
+    size_t available() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return idle.size();
+    }
+
+    // Number of processes that were found dead and replaced.
+    size_t respawned() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return num_respawned;
+    }
+
+    // Renders the jobs on all processes of the pool at once and returns a result per job, in
+    // the same order.  Each worker thread takes the next unstarted job from the shared list
+    // until none are left, so a few slow plots don't hold up the rest.
+    //
+    // With GNUPLOT_ENABLE_FEEDBACK, each job ends with a round trip that closes the output file
+    // and asks gnuplot for GPVAL_ERRNO.  A job then only succeeds if gnuplot drew it without an
+    // error, `seconds` includes the drawing, and all of the files are complete when this
+    // returns.  Without feedback there is no way to hear back from gnuplot: only failures on
+    // our side (such as a process that has died) make a job fail, `seconds` only covers
+    // sending the job, and the last files may still be being written when this returns (they
+    // are complete once the pool has been destroyed, or use the render_batch() free function).
+    //
+    // A job that gnuplot hasn't finished after its `timeout` (for instance because it contains
+    // `pause -1`) fails, and its process is replaced.  Closing the pipe of a stuck process
+    // normally makes it exit, but its worker waits until it has.
+    std::vector<GnuplotBatchResult> render_batch(const std::vector<GnuplotBatchJob> &jobs) {
+        std::vector<GnuplotBatchResult> results(jobs.size());
+        std::atomic<size_t> next_job(0);
+
+        const auto work = [&](size_t worker) {
+            for(;;) {
+                const size_t i = next_job++;
+                if(i >= jobs.size()) break;
+                const GnuplotBatchJob &job = jobs[i];
+                GnuplotBatchResult &res = results[i];
+                res.worker = worker;
+                const auto start = std::chrono::steady_clock::now();
+                try {
+                    Lease gp = acquire();
+#ifdef GNUPLOT_ENABLE_FEEDBACK
+                    *gp << "reset errors\n";
+#endif
+                    *gp << "set terminal " << job.terminal << "\n";
+                    *gp << "set output " << quote_string(job.output) << "\n";
+                    gp->send(job.plots);
+                    if(!gp->isAlive()) {
+                        throw std::runtime_error("gnuplot exited");
+                    }
+#ifdef GNUPLOT_ENABLE_FEEDBACK
+                    *gp << "unset output\n";
+                    const std::string err = wait_for_job(*gp, job.timeout);
+                    if(!err.empty()) throw std::runtime_error(err);
+#endif
+                    res.ok = true;
+                } catch(const std::exception &e) {
+                    res.error = e.what();
+                }
+                res.seconds = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - start).count();
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for(size_t w=1; w<std::min(num_total, jobs.size()); w++) {
+            threads.emplace_back(work, w);
+        }
+        work(0);
+        for(std::thread &t : threads) {
+            t.join();
+        }
+        return results;
+    }
+
+private:
+#ifdef GNUPLOT_ENABLE_FEEDBACK
+    // Waits until gnuplot has finished everything sent so far, and returns its error message
+    // (empty if there was no error).  A gnuplot that reads commands from a pipe exits on most
+    // errors, so this also checks whether it is still alive while waiting.  After `timeout`
+    // seconds (unless zero) the session is marked bad, so that give_back() replaces it.
+    static std::string wait_for_job(Gnuplot &gp, double timeout) {
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<std::string> errno_lines;
+        for(;;) {
+            int wait_ms = 1000;
+            if(timeout > 0) {
+                const double left = timeout - std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - start).count();
+                if(left <= 0) {
+                    gp.setstate(std::ios_base::badbit);
+                    std::ostringstream msg;
+                    msg << "gnuplot didn't finish the job within " << timeout << " seconds";
+                    return msg.str();
+                }
+                wait_ms = static_cast<int>(std::min(1000.0, std::ceil(left * 1000)));
+            }
+            try {
+                errno_lines = gp.query("GPVAL_ERRNO", wait_ms);
+                break;
+            } catch(const std::runtime_error &) {
+                if(!gp.isAlive()) return "gnuplot exited";
+            }
+        }
+        if(errno_lines.size() == 1 && errno_lines[0] == "0") return "";
+        std::vector<std::string> msg = gp.query("GPVAL_ERRMSG", 1000);
+        return "gnuplot error: " + (msg.empty() ? std::string("unknown") : msg[0]);
+    }
+#endif
+
+    // If a dead session can't be replaced, it goes back to the pool (to be tried again by the
+    // next take()) and the error is thrown.
+    Lease take(std::unique_lock<std::mutex> &lock) {
+        std::unique_ptr<Gnuplot> gp = std::move(idle.front());
+        idle.pop_front();
+        // Starting a process is slow, so don't block the other threads meanwhile.
+        lock.unlock();
+        if(!gp->isAlive()) {
+            try {
+                respawn(gp);
+            } catch(...) {
+                put_back(std::move(gp));
+                throw;
+            }
+        }
+        return Lease(this, std::move(gp));
+    }
+
+    void give_back(std::unique_ptr<Gnuplot> gp) {
+        if(gp->isAlive()) {
+            try {
+                gp->resetClientState();
+                *gp << "unset output\nreset\n";
+                gp->do_flush();
+            } catch(const std::exception &) {
+                // Replaced below.
+                gp->setstate(std::ios_base::badbit);
+            }
+        }
+        if(!gp->isAlive()) {
+            try {
+                respawn(gp);
+            } catch(const std::exception &) {
+                // This is called from ~Lease, so the error can't be passed on.  The session
+                // stays dead and take() tries again.
+            }
+        }
+        put_back(std::move(gp));
+    }
+
+    void put_back(std::unique_ptr<Gnuplot> gp) {
+        std::lock_guard<std::mutex> lock(mutex);
+        idle.push_back(std::move(gp));
+        cond.notify_one();
+    }
+
+    // Replaces a dead session with a new process.  If that can't be started (e.g. popen fails),
+    // this throws and `gp` is left as it was.
+    void respawn(std::unique_ptr<Gnuplot> &gp) {
+        std::unique_ptr<Gnuplot> fresh = std::make_unique<Gnuplot>(cmd);
+        // Stops the destructor's flush from writing to the dead pipe.
+        gp->setstate(std::ios_base::badbit);
+        gp = std::move(fresh);
+        std::lock_guard<std::mutex> lock(mutex);
+        ++num_respawned;
+    }
+
+    const std::string cmd;
+    const size_t num_total;
+    size_t num_respawned;
+    std::deque<std::unique_ptr<Gnuplot>> idle;
+    mutable std::mutex mutex;
+    std::condition_variable cond;
+};
+
+// Renders the jobs using a temporary pool of `num_processes` gnuplot processes (see
+// GnuplotPool::render_batch).  All output files are complete when this returns.
+inline std::vector<GnuplotBatchResult> render_batch(
+    const std::vector<GnuplotBatchJob> &jobs,
+    size_t num_processes = std::max(1u, std::thread::hardware_concurrency()),
+    const std::string &cmd=""
+) {
+    if(jobs.empty()) return {};
+    GnuplotPool pool(std::max<size_t>(1, std::min(num_processes, jobs.size())), cmd);
+    return pool.render_batch(jobs);
+}
+
+// }}}1
+
 } // namespace gnuplotio
 
 // The first version of this library didn't use namespaces, and now this must be here forever
@@ -2101,6 +5303,10 @@ public:
         ++idx[ArrayDim-SliceDim];
     }
 
+    size_t size() const {
+        return p->shape()[ArrayDim-SliceDim] - idx[ArrayDim-SliceDim];
+    }
+
     value_type deref() const {
         static_assert((sizeof(T) == 0), "cannot deref a blitz slice");
         throw std::logic_error("static assert should have been triggered by this point");
@@ -2137,6 +5343,10 @@ public:
         ++idx[ArrayDim-1];
     }
 
+    size_t size() const {
+        return p->shape()[ArrayDim-1] - idx[ArrayDim-1];
+    }
+
     value_type deref() const {
         return (*p)(idx);
     }
@@ -2210,6 +5420,8 @@ class ArrayTraitsImpl<arma::Cube<T>> : public ArrayTraitsDefaults<T> {
 
         void inc() { ++slice; }
 
+        size_t size() const { return p->n_slices - slice; }
+
         value_type deref() const {
             return (*p)(row, col, slice);
         }
@@ -2238,6 +5450,8 @@ class ArrayTraitsImpl<arma::Cube<T>> : public ArrayTraitsDefaults<T> {
 
         void inc() { ++col; }
 
+        size_t size() const { return p->n_cols - col; }
+
         value_type deref() const {
             static_assert((sizeof(T) == 0), "can't call deref on an armadillo cube col");
             throw std::logic_error("static assert should have been triggered by this point");
@@ -2265,6 +5479,17 @@ class ArrayTraitsImpl<arma::Cube<T>> : public ArrayTraitsDefaults<T> {
 
         void inc() { ++row; }
 
+        size_t size() const { return p->n_rows - row; }
+
+        // Armadillo stores cubes column major, slice by slice.
+        StridedBlock<T> strided_block() const {
+            const ptrdiff_t r = static_cast<ptrdiff_t>(p->n_rows);
+            const ptrdiff_t c = static_cast<ptrdiff_t>(p->n_cols);
+            return StridedBlock<T>{ p->memptr() + row,
+                {{ p->n_rows - row, p->n_cols, p->n_slices }},
+                {{ 1, r, r*c }} };
+        }
+
         value_type deref() const {
             static_assert((sizeof(T) == 0), "can't call deref on an armadillo cube row");
             throw std::logic_error("static assert should have been triggered by this point");
@@ -2311,6 +5536,8 @@ class ArrayTraits_ArmaMatOrField : public ArrayTraitsDefaults<T> {
 
         void inc() { ++col; }
 
+        size_t size() const { return p->n_cols - col; }
+
         value_type deref() const {
             return (*p)(row, col);
         }
@@ -2338,6 +5565,18 @@ class ArrayTraits_ArmaMatOrField : public ArrayTraitsDefaults<T> {
 
         void inc() { ++row; }
 
+        size_t size() const { return p->n_rows - row; }
+
+        // Armadillo stores matrices column major.  Fields hold objects rather than scalars, so
+        // this is only available for matrices.
+        template <typename R=RF>
+        typename std::enable_if_t<std::is_same_v<R, arma::Mat<T>>, StridedBlock<T>>
+        strided_block() const {
+            return StridedBlock<T>{ p->memptr() + row,
+                {{ p->n_rows - row, p->n_cols, 1 }},
+                {{ 1, static_cast<ptrdiff_t>(p->n_rows), 1 }} };
+        }
+
         value_type deref() const {
             static_assert((sizeof(T) == 0), "can't call deref on an armadillo matrix row");
             throw std::logic_error("static assert should have been triggered by this point");
@@ -2441,6 +5680,17 @@ static constexpr bool dont_treat_as_stl_container<T, typename std::enable_if_t<i
 
 static_assert(dont_treat_as_stl_container<Eigen::MatrixXf>);
 
+// Dense objects whose coefficients are in memory (plain matrices, maps, blocks of those) can be
+// sent in binary straight from `data()`, rather than one coefficient at a time.
+template <typename T, typename=void>
+static constexpr bool eigen_has_direct_access = false;
+
+template <typename T>
+static constexpr bool eigen_has_direct_access<T, std::void_t<decltype(T::Flags)>> =
+    (T::Flags & Eigen::DirectAccessBit) != 0;
+
+static_assert( eigen_has_direct_access<Eigen::MatrixXf>);
+
 // {{{3 Matrix
 
 template <typename RF>
@@ -2454,11 +5704,30 @@ class ArrayTraits_Eigen1D : public ArrayTraitsDefaults<typename RF::value_type>
         using value_type = typename RF::value_type;
         typedef Error_WasNotContainer subiter_type;
         static constexpr bool is_container = false;
+        static constexpr bool is_contiguous = eigen_has_direct_access<RF>;
 
         bool is_end() const { return idx == p->size(); }
 
         void inc() { ++idx; }
 
+        size_t size() const { return static_cast<size_t>(p->size() - idx); }
+
+        // Null unless the coefficients are adjacent in memory.
+        template <typename R=RF>
+        typename std::enable_if_t<eigen_has_direct_access<R>, const value_type *>
+        contiguous_data() const {
+            return p->innerStride() == 1 ? p->data() + idx : nullptr;
+        }
+
+        template <typename R=RF>
+        typename std::enable_if_t<eigen_has_direct_access<R>, StridedBlock<value_type>>
+        strided_block() const {
+            const ptrdiff_t stride = static_cast<ptrdiff_t>(p->innerStride());
+            return StridedBlock<value_type>{ p->data() + idx*stride,
+                {{ size(), 1, 1 }},
+                {{ stride, 1, 1 }} };
+        }
+
         value_type deref() const {
             return (*p)(idx);
         }
@@ -2501,6 +5770,8 @@ class ArrayTraits_Eigen2D : public ArrayTraitsDefaults<typename RF::value_type>
 
         void inc() { ++col; }
 
+        size_t size() const { return static_cast<size_t>(p->cols() - col); }
+
         value_type deref() const {
             return (*p)(row, col);
         }
@@ -2528,6 +5799,20 @@ class ArrayTraits_Eigen2D : public ArrayTraitsDefaults<typename RF::value_type>
 
         void inc() { ++row; }
 
+        size_t size() const { return static_cast<size_t>(p->rows() - row); }
+
+        // For row major storage this is one contiguous write, for column major storage it is
+        // a blocked transpose (see send_strided_binary).
+        template <typename R=RF>
+        typename std::enable_if_t<eigen_has_direct_access<R>, StridedBlock<value_type>>
+        strided_block() const {
+            const ptrdiff_t rs = static_cast<ptrdiff_t>(p->rowStride());
+            const ptrdiff_t cs = static_cast<ptrdiff_t>(p->colStride());
+            return StridedBlock<value_type>{ p->data() + row*rs,
+                {{ size(), static_cast<size_t>(p->cols()), 1 }},
+                {{ rs, cs, 1 }} };
+        }
+
         value_type deref() const {
             static_assert((sizeof(value_type) == 0), "can't call deref on an eigen matrix row");
             throw std::logic_error("static assert should have been triggered by this point");
@@ -0,0 +1,88 @@
+/*
+Copyright (c) 2020 Daniel Stahlke
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+// Checks how often the stream gets flushed while sending text data.  Every flush of the pipe to
+// gnuplot costs a `write()` system call, so a send should flush once at the end rather than
+// once per line.
+
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "gnuplot-iostream.h"
+
+using namespace gnuplotio;
+
+// A streambuf that just counts how many times it is asked to flush (i.e. how many times the
+// real pipe would have been written to).
+class FlushCountingBuf : public std::stringbuf {
+public:
+    size_t num_flushes = 0;
+
+protected:
+    int sync() override {
+        ++num_flushes;
+        return std::stringbuf::sync();
+    }
+};
+
+size_t count_flushes(Gnuplot &gp, const std::vector<std::pair<double, double>> &pts, double &seconds) {
+    FlushCountingBuf buf;
+    std::streambuf *orig = gp.rdbuf(&buf);
+    auto t0 = std::chrono::steady_clock::now();
+    gp.send1d(pts);
+    auto t1 = std::chrono::steady_clock::now();
+    gp.rdbuf(orig);
+    seconds = std::chrono::duration<double>(t1 - t0).count();
+    return buf.num_flushes;
+}
+
+int main() {
+    Gnuplot gp(">/dev/null");
+
+    const size_t N = 100000;
+    std::vector<std::pair<double, double>> pts;
+    for(size_t i=0; i<N; i++) {
+        pts.emplace_back(i, i*0.5);
+    }
+
+    double t_default, t_debug;
+    size_t flushes_default = count_flushes(gp, pts, t_default);
+    debug_flush_each_line = true;
+    size_t flushes_debug = count_flushes(gp, pts, t_debug);
+    debug_flush_each_line = false;
+
+    std::cout << "rows=" << N << std::endl;
+    std::cout << "default:               flushes=" << flushes_default << " seconds=" << t_default << std::endl;
+    std::cout << "debug_flush_each_line: flushes=" << flushes_debug << " seconds=" << t_debug << std::endl;
+
+    if(flushes_default != 1) {
+        std::cerr << "expected a single flush per send" << std::endl;
+        return 1;
+    }
+    if(flushes_debug < N) {
+        std::cerr << "expected a flush per line with debug_flush_each_line" << std::endl;
+        return 1;
+    }
+    return 0;
+}
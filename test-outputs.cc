@@ -28,6 +28,10 @@ THE SOFTWARE.
 #include <tuple>
 #include <array>
 #include <cstdint>
+#include <thread>
+#include <csignal>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include <boost/array.hpp>
 
@@ -131,9 +135,59 @@ void basic_datatype_test_float(std::string name) {
     runtest_maybe_dobin<std::vector<T>, DoBinary>(name, v);
 }
 
-int main() {
+// Checks that `arg` (an as_float() wrapper) is sent exactly like `expected`, which holds the
+// same data in single precision.
+template <typename T, typename U, typename OrganizationMode>
+void check_same_output(std::ostream &log_fh, std::string name, const T &arg, const U &expected, OrganizationMode) {
+    std::ostringstream text_a, text_b, bin_a, bin_b;
+    top_level_array_sender(text_a, arg, OrganizationMode(), ModeText());
+    top_level_array_sender(text_b, expected, OrganizationMode(), ModeText());
+    top_level_array_sender(bin_a, arg, OrganizationMode(), ModeBinary());
+    top_level_array_sender(bin_b, expected, OrganizationMode(), ModeBinary());
+    log_fh << name << " " << OrganizationMode::class_name() << ":"
+        << " text=" << (text_a.str() == text_b.str() ? "same" : "DIFFERENT")
+        << " binary=" << (bin_a.str() == bin_b.str() ? "same" : "DIFFERENT")
+        << " binfmt=" << (top_level_binfmt(arg, OrganizationMode()) ==
+            top_level_binfmt(expected, OrganizationMode()) ? "same" : "DIFFERENT")
+        << std::endl;
+}
+
+std::vector<float> vf_of(const std::vector<double> &v) {
+    return std::vector<float>(v.begin(), v.end());
+}
+
+// Runs `f` on a session that writes to a file rather than to gnuplot, so that the commands are
+// checked as well as the data.
+template <typename F>
+void runtest_session(std::string header, F f) {
+    Gnuplot gp_file(">"+basedir+"/"+header+"-session.txt");
+    gp_file << std::setprecision(6);
+    f(gp_file);
+}
+
+// The temporaries passed to add_plot*() are gone by the time the group is sent, so they have to
+// be moved into the group.
+PlotGroup make_by_reference_group() {
+    std::vector<double> xs = { 1.5, 2.5, 3.5 };
+    std::vector<int> ys = { 10, 20, 30 };
+    PlotGroup g = Gnuplot::plotGroup();
+    g.by_reference();
+    g.add_plot1d(std::make_pair(xs, ys), "with lines");
+    g.add_plot1d(std::make_tuple(ys, xs), "with points", "record");
+    g.add_plot1d(as_float(std::make_pair(xs, ys)), "with points", "record");
+    return g;
+}
+
+int main(int argc, char **argv) {
     gp << std::setprecision(6);
 
+    // With "threads", long text data is formatted on several threads.  The output must be
+    // exactly the same.
+    if(argc > 1 && std::string(argv[1]) == "threads") {
+        gp.setTextThreads(4);
+        text_format_chunk_rows = 1;
+    }
+
     const int NX=3, NY=4, NZ=2;
     std::vector<double> vd;
     std::vector<int> vi;
@@ -283,4 +337,530 @@ int main() {
 #if USE_BLITZ
     runtest("blitz2d cols", blitz2d);
 #endif
+
+    // The SIMD conversion works on runs of four, so use a length that leaves a remainder.
+    {
+        std::vector<double> long_vd;
+        std::vector<float> long_vf;
+        std::vector<std::pair<double, int>> v_pair;
+        std::vector<std::pair<float, int>> v_pair_f;
+        std::vector<boost::tuple<float, int, int>> v_bt_f;
+        for(int i=0; i<11; i++) {
+            long_vd.push_back(i + 0.1);
+            long_vf.push_back(float(i + 0.1));
+            v_pair.emplace_back(i * 0.3, i);
+            v_pair_f.emplace_back(float(i * 0.3), i);
+        }
+        for(const auto &t : v_bt) {
+            v_bt_f.push_back(boost::make_tuple(float(t.get<0>()), t.get<1>(), t.get<2>()));
+        }
+
+        runtest("as_float vd", as_float(long_vd));
+        runtest("as_float tup{vd,vi,vd}", as_float(std::make_tuple(vd, vi, vd)));
+        runtest("as_float v_pair", as_float(v_pair));
+        runtest("as_float v_bt", as_float(v_bt));
+        runtest("as_float vvd", as_float(vvd));
+
+        std::ofstream log_fh((basedir+"/as_float-log.txt").c_str());
+        check_same_output(log_fh, "vd", as_float(long_vd), long_vf, Mode1D());
+        check_same_output(log_fh, "tup{vd,vi,vd}", as_float(std::make_tuple(vd, vi, vd)),
+            std::make_tuple(vf_of(vd), vi, vf_of(vd)), Mode1D());
+        check_same_output(log_fh, "v_pair", as_float(v_pair), v_pair_f, Mode1D());
+        check_same_output(log_fh, "v_bt", as_float(v_bt), v_bt_f, Mode1D());
+        std::vector<std::vector<float>> vvf;
+        for(const auto &v : vvd) vvf.push_back(vf_of(v));
+        check_same_output(log_fh, "vvd", as_float(vvd), vvf, Mode2D());
+        check_same_output(log_fh, "vvd", as_float(vvd), vvf, Mode1DUnwrap());
+#if USE_EIGEN
+        Eigen::MatrixXd em(NX, NY);
+        for(int x=0; x<NX; x++) {
+            for(int y=0; y<NY; y++) {
+                em(x, y) = x*10+y+0.123;
+            }
+        }
+        Eigen::MatrixXf emf = em.cast<float>();
+        runtest("as_float eigenmat", as_float(em));
+        std::ofstream eigen_log_fh((basedir+"/as_float_eigen-log.txt").c_str());
+        check_same_output(eigen_log_fh, "eigenmat", as_float(em), emf, Mode2D());
+        check_same_output(eigen_log_fh, "eigenmat", as_float(em), emf, Mode1DUnwrap());
+#endif
+    }
+
+    // The same 3x2 image (width 3) stored row major and column major should give the same
+    // output.
+    {
+        const double rowmajor[] = { 1, 2, 3, 4, 5, 6 };
+        const double colmajor[] = { 1, 4, 2, 5, 3, 6 };
+        runtest("image rowmajor", image_view(rowmajor, 3, 2));
+        runtest("image colmajor", ImageView<double>{colmajor, 3, 2, 1, 2});
+        // The right two columns of the row major image.
+        runtest("image sub", image_view(rowmajor+1, 2, 2, 3));
+
+        const uint8_t rgb[] = {
+            255, 0, 0,   0, 255, 0,
+            0, 0, 255,   10, 20, 30 };
+        runtest("image rgb", rgb_view(rgb, 2, 2));
+
+        std::ofstream log_fh((basedir+"/matrix-log.txt").c_str());
+        ImageGeometry geom;
+        geom.x0 = 10;
+        geom.dx = 0.5;
+        geom.y0 = -1;
+        geom.dy = 2;
+        log_fh << gp.imageFmt(image_view(rowmajor, 3, 2), geom) << std::endl;
+        log_fh << gp.binMatrixFile(vvd, basedir+"/matrix.bin", geom) << std::endl;
+        try {
+            gp.binMatrixFile(std::vector<std::vector<double>>(), basedir+"/matrix-empty.bin");
+        } catch(const std::length_error &e) {
+            log_fh << e.what() << std::endl;
+        }
+    }
+
+    // Three buckets of seven points.  The maximum comes first in the second bucket, and the
+    // minimum first in the others.
+    std::vector<double> series = {
+        0, -3, 1, 2, 5, 1, 0,
+        9, 1, 2, 3, -7, 4, 2,
+        1, 1, 1, 0, 1, 1, 8 };
+    std::vector<double> series_x;
+    for(size_t i=0; i<series.size(); i++) series_x.push_back(100 + i*0.5);
+    runtest("decimate scalar", decimate_minmax(series, 6));
+    runtest("decimate pair", decimate_minmax(std::make_pair(series_x, series), 6));
+    runtest("decimate short", decimate_minmax(vd, 6));
+    runtest("decimate two", decimate_minmax(series, 2));
+    // The first bucket starts with NaN, the second is all NaN.
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    std::vector<double> series_nan = series;
+    series_nan[0] = nan;
+    for(size_t i=7; i<14; i++) series_nan[i] = nan;
+    runtest("decimate nan", decimate_minmax(series_nan, 6));
+    {
+        std::ofstream log_fh((basedir+"/decimate-errors-log.txt").c_str());
+        for(size_t target_points : {0, 1}) {
+            try {
+                decimate_minmax(series, target_points);
+            } catch(const std::invalid_argument &e) {
+                log_fh << target_points << ": " << e.what() << std::endl;
+            }
+        }
+    }
+
+    runtest_session("by_reference_temporaries", [](Gnuplot &g) {
+        PlotGroup group = make_by_reference_group();
+        g.send(group);
+        g.send(group);
+    });
+
+    // Two plots sent five times with rings of three files: each ring is filled and then
+    // reused.  Raising the async queue above the ring size makes the rings longer.
+    {
+        Gnuplot g(">/dev/null");
+        g.useTmpFile(true);
+        std::ofstream log_fh((basedir+"/tmpfile_pool-log.txt").c_str());
+        for(int i=0; i<5; i++) {
+            g.send(Gnuplot::plotGroup().add_plot1d(vd).add_plot1d(vi, "", "record"));
+        }
+        GnuplotTmpfileStats st = g.tmpfileStats();
+        log_fh << "created=" << st.created << " reused=" << st.reused << " live=" << st.live << std::endl;
+        g.useAsyncWriter(4);
+        for(int i=0; i<5; i++) {
+            g.send(Gnuplot::plotGroup().add_plot1d(vd).add_plot1d(vi, "", "record"));
+        }
+        st = g.tmpfileStats();
+        log_fh << "created=" << st.created << " reused=" << st.reused << " live=" << st.live << std::endl;
+    }
+
+    // The first slot's file is the same file again on the fourth send with a ring of three.  By
+    // default it is overwritten in place (same inode); with `staged` it is replaced.
+    for(bool staged : {false, true}) {
+        std::FILE *session = std::tmpfile();
+        Gnuplot g(session);
+        g.useTmpFile(true);
+        g.setTmpfilePool(3, 0, staged);
+        std::vector<ino_t> inodes;
+        std::string first_file;
+        for(int i=0; i<4; i++) {
+            g.send(Gnuplot::plotGroup().add_plot1d(vd));
+            std::string text(static_cast<size_t>(lseek(fileno(session), 0, SEEK_END)), '\0');
+            if(pread(fileno(session), &text[0], text.size(), 0) != static_cast<ssize_t>(text.size())) {
+                throw std::runtime_error("cannot read session");
+            }
+            const size_t start = text.rfind("plot '") + 6;
+            const std::string fn = text.substr(start, text.find('\'', start) - start);
+            if(i == 0) first_file = fn;
+            struct stat st;
+            if(stat(fn.c_str(), &st)) throw std::runtime_error("cannot stat "+fn);
+            inodes.push_back(st.st_ino);
+            if(i == 3 && fn != first_file) throw std::runtime_error("ring wasn't reused");
+        }
+        std::ofstream log_fh((basedir+"/tmpfile_staged_"+(staged ? "on" : "off")+"-log.txt").c_str());
+        log_fh << "same inode on reuse: " << (inodes[0] == inodes[3]) << std::endl;
+        GnuplotTmpfileStats st = g.tmpfileStats();
+        log_fh << "created=" << st.created << " reused=" << st.reused << " live=" << st.live << std::endl;
+    }
+
+    // With a limit of two files, the third file1d() replaces the first file.  Files that no
+    // longer fit when the pool shrinks are kept until clearTmpfiles().
+    {
+        Gnuplot g(">/dev/null");
+        g.setTmpfilePool(3, 2);
+        std::ofstream log_fh((basedir+"/tmpfile_max_files-log.txt").c_str());
+        std::vector<std::string> names;
+        for(int i=0; i<3; i++) {
+            std::vector<int> v(1, i);
+            std::string name = g.file1d(v);
+            // Strip the quotes and spaces around the filename.
+            names.push_back(name.substr(2, name.size()-4));
+        }
+        GnuplotTmpfileStats st = g.tmpfileStats();
+        log_fh << "created=" << st.created << " reused=" << st.reused << " live=" << st.live << std::endl;
+        log_fh << "first file reused: " << (names[0] == names[2]) << std::endl;
+        std::ifstream fh(names[0].c_str());
+        log_fh << "first file holds: " << fh.rdbuf();
+        g.setTmpfilePool(3, 1);
+        st = g.tmpfileStats();
+        log_fh << "after shrinking: live=" << st.live
+            << " dropped file exists=" << std::ifstream(names[1].c_str()).good() << std::endl;
+        g.clearTmpfiles();
+        st = g.tmpfileStats();
+        log_fh << "after clearTmpfiles: live=" << st.live
+            << " dropped file exists=" << std::ifstream(names[1].c_str()).good() << std::endl;
+    }
+
+    // Only the first and the last upload should appear in the output.
+    runtest_session("datablock", [&](Gnuplot &g) {
+        std::vector<double> ys = vd;
+        for(int i=0; i<3; i++) {
+            if(i == 2) ys[1] = -1;
+            // The upload has to happen before the plot command is started.
+            const std::string handle = g.datablock1d(ys, "ys");
+            g << "plot" << handle << "with lines\n";
+        }
+
+        // Changed binary data replaces the file of that name rather than making a new one.
+        for(int i=0; i<3; i++) {
+            ys[0] = i;
+            g.binDatablock1d(ys, "ys", "record");
+        }
+        g << "# live tmpfiles: " << g.tmpfileStats().live << "\n";
+    });
+
+    // The counters only depend on what was written, so they can be compared exactly.  The
+    // session output is checked too, since the meter sits in front of the async writer.
+    {
+        std::ofstream log_fh((basedir+"/stats-log.txt").c_str());
+        const auto log_stats = [&](const std::string &what, const GnuplotStats &st) {
+            log_fh << what << ": bytes=" << st.bytes << " text_bytes=" << st.text_bytes
+                << " binary_bytes=" << st.binary_bytes << " sends=" << st.sends
+                << " flushes=" << st.flushes << " last_send.bytes=" << st.last_send.bytes
+                << " last_send.binary=" << st.last_send.binary << std::endl;
+        };
+        runtest_session("stats", [&](Gnuplot &g) {
+            g.enableStats();
+            size_t callbacks = 0;
+            g.onSend([&](const GnuplotStats &) { ++callbacks; });
+
+            g << "plot '-' with lines\n";
+            g.send1d(vd);
+            log_stats("text", g.stats());
+
+            g << "plot '-' binary" << g.binFmt1d(vi, "record") << "with lines\n";
+            g.sendBinary1d(vi);
+            log_stats("binary", g.stats());
+
+            g.send(Gnuplot::plotGroup().add_plot1d(vd, "with lines").add_plot1d(vi, "with points", "record"));
+            log_stats("plot group", g.stats());
+
+            g.useAsyncWriter(2);
+            g << "plot '-' with lines\n";
+            g.send1d(vd);
+            g.wait_idle();
+            log_stats("async text", g.stats());
+            g.stopAsyncWriter();
+
+            g << "plot '-' binary" << g.binFmt1d(vi, "record") << "with lines\n";
+            g.sendBinary1d(vi);
+            log_stats("after async", g.stats());
+            log_fh << "callbacks: " << callbacks << std::endl;
+
+            g.onSend(nullptr);
+            g.resetStats();
+            g << "replot\n";
+            log_stats("reset", g.stats());
+            log_fh << "callbacks: " << callbacks << std::endl;
+        });
+
+        // The destructor takes the meter and the async writer out of the stream, and has to
+        // write whatever is still queued.
+        runtest_session("stats_async_destructor", [&](Gnuplot &g) {
+            g.enableStats();
+            g.useAsyncWriter(2);
+            g << "plot '-' with lines\n";
+            g.send1d(vd);
+            g << "replot\n";
+        });
+    }
+
+    // StripChart writes its window to a tmpfile with a random name, so the file is logged while
+    // it exists, and its name is replaced in the session output afterwards.
+    {
+        const std::string session_fn = basedir+"/stripchart-session.txt";
+        std::ofstream log_fh((basedir+"/stripchart-log.txt").c_str());
+        std::string tmpfile;
+        const auto log_tmpfile = [&](Gnuplot &g) {
+            g.do_flush();
+            std::ifstream session(session_fn.c_str());
+            std::string line;
+            while(std::getline(session, line)) {
+                if(line.compare(0, 6, "plot '") == 0) {
+                    tmpfile = line.substr(6, line.find('\'', 6) - 6);
+                }
+            }
+            std::ifstream fh(tmpfile.c_str(), std::ios::binary);
+            std::array<double, 3> row;
+            while(fh.read(reinterpret_cast<char *>(row.data()), sizeof(row))) {
+                log_fh << row[0] << " " << row[1] << " " << row[2] << std::endl;
+            }
+            log_fh << "--" << std::endl;
+        };
+        runtest_session("stripchart", [&](Gnuplot &g) {
+            StripChart<2> chart(g, 4);
+            chart.plotspec(1, "with points title 'b'");
+            for(int i=0; i<3; i++) chart.push(i, i*10, -i);
+            chart.redraw();
+            log_tmpfile(g);
+
+            // Seven samples in a ring of four: the window is written in two pieces.
+            for(int i=3; i<7; i++) chart.push(i, i*10, -i);
+            log_fh << "update: " << chart.update() << " size: " << chart.size() << std::endl;
+            log_tmpfile(g);
+            log_fh << "update without new data: " << chart.update() << std::endl;
+
+            chart.clear();
+            chart.redraw();
+            log_fh << "size after clear: " << chart.size() << std::endl;
+            chart.push(7, 70, -7);
+            chart.redraw();
+            log_tmpfile(g);
+        });
+
+        std::ifstream in(session_fn.c_str());
+        std::ostringstream session;
+        session << in.rdbuf();
+        in.close();
+        std::string text = session.str();
+        for(size_t pos; !tmpfile.empty() && (pos = text.find(tmpfile)) != std::string::npos; ) {
+            text.replace(pos, tmpfile.size(), "TMPFILE");
+        }
+        std::ofstream(session_fn.c_str()) << text;
+
+        // Each chart has its own file, which is deleted along with the chart.  A chart made in
+        // the place of a destroyed one gets a new file rather than the old one's.
+        Gnuplot g(">/dev/null");
+        for(int round=0; round<2; round++) {
+            StripChart<2> a(g, 4);
+            StripChart<2> b(g, 4);
+            a.push(0, 1, 2);
+            b.push(0, 1, 2);
+            a.redraw();
+            b.redraw();
+            log_fh << "live with two charts: " << g.tmpfileStats().live
+                << " created: " << g.tmpfileStats().created << std::endl;
+        }
+        log_fh << "live after the charts: " << g.tmpfileStats().live << std::endl;
+    }
+
+    // Leases of a pool with a single session.  Returning it sends `unset output` and `reset`,
+    // and undoes the settings made on the Gnuplot object.
+    {
+        std::ofstream log_fh((basedir+"/pool-log.txt").c_str());
+        {
+            GnuplotPool pool(1, ">"+basedir+"/pool-session.txt");
+            log_fh << "size=" << pool.size() << " available=" << pool.available() << std::endl;
+            {
+                GnuplotPool::Lease lease = pool.acquire();
+                log_fh << "lent out: available=" << pool.available()
+                    << " try_acquire=" << bool(pool.try_acquire()) << std::endl;
+                *lease << std::setprecision(6);
+                lease->useAsyncWriter(2);
+                lease->enableStats();
+                *lease << "set output 'first.png'\n";
+                lease->send(Gnuplot::plotGroup().add_plot1d(vd, "with lines"));
+                log_fh << "sends=" << lease->stats().sends << std::endl;
+                lease->useTmpFile(true);
+            }
+            log_fh << "returned: available=" << pool.available() << std::endl;
+            {
+                GnuplotPool::Lease lease = pool.try_acquire();
+                log_fh << "try_acquire=" << bool(lease) << " available=" << pool.available() << std::endl;
+                log_fh << "transport_tmpfile=" << lease->transport_tmpfile
+                    << " sends=" << lease->stats().sends << std::endl;
+                // Throws if the async writer is still in use.
+                lease->useAsyncWriter(2);
+                lease->stopAsyncWriter();
+                // Moving the lease doesn't return the session.
+                GnuplotPool::Lease other = std::move(lease);
+                log_fh << "moved: " << bool(lease) << " " << bool(other)
+                    << " available=" << pool.available() << std::endl;
+                *other << "plot sin(x)\n";
+                other.release();
+                log_fh << "released: " << bool(other) << " available=" << pool.available() << std::endl;
+            }
+            log_fh << "respawned=" << pool.respawned() << std::endl;
+        }
+
+        // Two sessions that stay alive, and one whose process exits straight away.
+        GnuplotPool live(2, "cat >/dev/null");
+        {
+            GnuplotPool::Lease a = live.acquire();
+            GnuplotPool::Lease b = live.acquire();
+            log_fh << "both lent out: available=" << live.available()
+                << " try_acquire=" << bool(live.try_acquire())
+                << " distinct=" << (a.get() != b.get()) << std::endl;
+        }
+        log_fh << "both returned: available=" << live.available()
+            << " respawned=" << live.respawned() << std::endl;
+
+        GnuplotPool dying(1, "true");
+        GnuplotPool::Lease lease = dying.acquire();
+        for(int i=0; i<500 && lease->isAlive(); i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        const size_t before = dying.respawned();
+        lease.release();
+        log_fh << "dead session returned: respawned " << (dying.respawned() - before)
+            << " available=" << dying.available() << std::endl;
+    }
+
+    // render_batch() without feedback: the results come back in the order of the jobs.  A
+    // single session writing to a file shows the order in which the jobs were sent.
+    {
+        std::ofstream log_fh((basedir+"/render_batch-log.txt").c_str());
+        const auto make_jobs = [&](size_t n) {
+            std::vector<GnuplotBatchJob> jobs;
+            for(size_t i=0; i<n; i++) {
+                jobs.push_back(GnuplotBatchJob{
+                    Gnuplot::plotGroup().add_plot1d(vd, "title 'job "+std::to_string(i)+"'"),
+                    "png", "job"+std::to_string(i)+".png"});
+            }
+            return jobs;
+        };
+        const auto log_results = [&](const std::string &what, const std::vector<GnuplotBatchResult> &results, size_t num_workers) {
+            log_fh << what << ": " << results.size() << " results";
+            for(const GnuplotBatchResult &r : results) {
+                log_fh << " [ok=" << r.ok << " error='" << r.error << "' worker_ok=" << (r.worker < num_workers) << "]";
+            }
+            log_fh << std::endl;
+        };
+        {
+            GnuplotPool pool(1, ">"+basedir+"/render_batch-session.txt");
+            log_results("one session", pool.render_batch(make_jobs(3)), 1);
+        }
+        log_results("shared", render_batch(make_jobs(7), 3, "cat >/dev/null"), 3);
+        log_results("no jobs", render_batch(make_jobs(0), 3, "cat >/dev/null"), 3);
+
+        // The job is bigger than a pipe holds, so the write fails once the process has exited,
+        // whether or not it had exited before the job was sent.  As GnuplotPool says, writing to
+        // a process that has died raises SIGPIPE.
+        std::signal(SIGPIPE, SIG_IGN);
+        std::vector<GnuplotBatchJob> big_job;
+        big_job.push_back(GnuplotBatchJob{
+            Gnuplot::plotGroup().add_plot1d(std::vector<double>(200000, 1.5)), "png", "dead.png"});
+        log_results("dead process", render_batch(big_job, 1, "true"), 1);
+    }
+
+    // A session that can't be replaced stays in the pool: acquire() throws until the process
+    // can be started again.
+    {
+        std::ofstream log_fh((basedir+"/pool_respawn_failure-log.txt").c_str());
+        const std::string dir = basedir+"/pool-dir";
+        mkdir(dir.c_str(), 0777);
+        GnuplotPool pool(1, ">"+dir+"/session.txt");
+        {
+            GnuplotPool::Lease lease = pool.acquire();
+            // Pretend the process died while it was lent out.
+            lease->setstate(std::ios_base::badbit);
+            unlink((dir+"/session.txt").c_str());
+            rmdir(dir.c_str());
+        }
+        log_fh << "available=" << pool.available() << " respawned=" << pool.respawned() << std::endl;
+        try {
+            pool.acquire();
+        } catch(const std::ios_base::failure &) {
+            log_fh << "acquire failed" << std::endl;
+        }
+        log_fh << "available=" << pool.available() << " respawned=" << pool.respawned() << std::endl;
+        mkdir(dir.c_str(), 0777);
+        {
+            GnuplotPool::Lease lease = pool.acquire();
+            log_fh << "acquired: " << bool(lease) << " alive: " << lease->isAlive() << std::endl;
+        }
+        log_fh << "available=" << pool.available() << " respawned=" << pool.respawned() << std::endl;
+    }
+    unlink((basedir+"/pool-dir/session.txt").c_str());
+    rmdir((basedir+"/pool-dir").c_str());
+
+    // With AsyncPolicy::Block a stream flush hands the output to the writer thread, while
+    // under the dropping policies it waits for the end of the frame.
+    {
+        std::ofstream log_fh((basedir+"/async_flush-log.txt").c_str());
+        const std::string fn = basedir+"/async_flush-session.txt";
+        const auto file_size = [&]() {
+            std::ifstream fh(fn.c_str(), std::ios::binary | std::ios::ate);
+            return static_cast<size_t>(fh.tellg());
+        };
+        for(AsyncPolicy policy : {AsyncPolicy::Block, AsyncPolicy::Coalesce}) {
+            Gnuplot g(">"+fn);
+            g.useAsyncWriter(2, policy);
+            g << "replot" << std::endl;
+            // The writer thread takes a moment, even when the frame was handed over.
+            for(int i=0; i<100 && file_size() == 0; i++) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            log_fh << (policy == AsyncPolicy::Block ? "Block" : "Coalesce")
+                << ": written after flush: " << file_size();
+            g.endFrame();
+            g.wait_idle();
+            log_fh << ", after endFrame: " << file_size() << std::endl;
+        }
+        std::remove(fn.c_str());
+    }
+
+    // The writer thread is kept busy with a datablock that is larger than the pipe can hold,
+    // while five plots with two '-' sources each are sent.  With AsyncPolicy::Coalesce all but
+    // the last are dropped, and the plot that gets through must still have all of its data.
+    {
+        int fds[2];
+        if(pipe(fds)) throw std::runtime_error("pipe failed");
+        std::string received;
+        std::thread reader;
+        std::ofstream log_fh((basedir+"/async_drop-log.txt").c_str());
+        {
+            Gnuplot g(fdopen(fds[1], "w"));
+            g << std::setprecision(6);
+            g.useAsyncWriter(2, AsyncPolicy::Coalesce);
+            g.datablock1d(std::vector<int>(200000, 1), "big");
+            for(int i=0; i<5; i++) {
+                g << "plot '-' title 'frame " << i << "', '-'\n";
+                g.send1d(vd);
+                g.send1d(vi);
+                g.endFrame();
+            }
+            log_fh << "dropped while blocked: " << g.asyncDroppedFrames() << std::endl;
+            reader = std::thread([&]() {
+                char buf[1 << 16];
+                ssize_t n;
+                while((n = read(fds[0], buf, sizeof(buf))) > 0) {
+                    received.append(buf, static_cast<size_t>(n));
+                }
+            });
+            g.wait_idle();
+            log_fh << "dropped after wait_idle: " << g.asyncDroppedFrames() << std::endl;
+        }
+        reader.join();
+        close(fds[0]);
+        // Everything after the datablock.
+        const std::string eod = "\nEOD\n";
+        log_fh << received.substr(received.find(eod) + eod.size());
+    }
 }